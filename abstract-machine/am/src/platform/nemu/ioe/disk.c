@@ -1,12 +1,59 @@
 #include <am.h>
 #include <nemu.h>
 
+#define DISK_PRESENT_ADDR (DISK_ADDR + 0x00)
+#define DISK_BLKSZ_ADDR   (DISK_ADDR + 0x04)
+#define DISK_BLKCNT_ADDR  (DISK_ADDR + 0x08)
+#define DISK_QUEUE_ADDR   (DISK_ADDR + 0x0c)
+#define DISK_QSIZE_ADDR   (DISK_ADDR + 0x10)
+#define DISK_HEAD_ADDR    (DISK_ADDR + 0x14)
+#define DISK_TAIL_ADDR    (DISK_ADDR + 0x18)
+#define DISK_INTR_ADDR    (DISK_ADDR + 0x1c)
+
+#define DISK_CMD_WRITE 0x1
+#define DISK_CMD_ERROR 0x40000000
+#define DISK_CMD_DONE  0x80000000
+
+#define QSIZE 4
+
+typedef struct {
+  uint32_t blkno;
+  uint32_t blkcnt;
+  uint32_t buf;
+  volatile uint32_t cmd;
+} DiskDesc;
+
+static DiskDesc queue[QSIZE];
+static uint32_t head = 0;
+
+void __am_disk_init() {
+  outl(DISK_QUEUE_ADDR, (uintptr_t)queue);
+  outl(DISK_QSIZE_ADDR, QSIZE);
+  head = inl(DISK_TAIL_ADDR);
+  outl(DISK_HEAD_ADDR, head);
+}
+
 void __am_disk_config(AM_DISK_CONFIG_T *cfg) {
-  cfg->present = false;
+  cfg->present = inl(DISK_PRESENT_ADDR);
+  cfg->blksz = inl(DISK_BLKSZ_ADDR);
+  cfg->blkcnt = inl(DISK_BLKCNT_ADDR);
 }
 
 void __am_disk_status(AM_DISK_STATUS_T *stat) {
+  stat->ready = (inl(DISK_TAIL_ADDR) == head);
 }
 
 void __am_disk_blkio(AM_DISK_BLKIO_T *io) {
+  DiskDesc *d = &queue[head % QSIZE];
+  d->blkno = io->blkno;
+  d->blkcnt = io->blkcnt;
+  d->buf = (uintptr_t)io->buf;
+  d->cmd = (io->write ? DISK_CMD_WRITE : 0);
+  __sync_synchronize();
+  outl(DISK_HEAD_ADDR, ++ head);
+  // the request is synchronous, so poll the descriptor in memory
+  // instead of trapping into the device for every check
+  while (!(d->cmd & DISK_CMD_DONE)) ;
+  __sync_synchronize();
+  if (d->cmd & DISK_CMD_ERROR) panic("disk I/O error");
 }
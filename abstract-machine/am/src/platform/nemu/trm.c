@@ -14,6 +14,19 @@ void putch(char ch) {
   outb(SERIAL_PORT, ch);
 }
 
+#ifdef NEMU_CONSOLE
+// paravirtual console, see the serial device in NEMU
+#define CONSOLE_ADDR_ADDR (SERIAL_PORT + 0x8)
+#define CONSOLE_LEN_ADDR  (SERIAL_PORT + 0xc)
+
+// used by klib printf to output the whole formatted string with one store
+void __am_putbuf(const char *buf, size_t len) {
+  if (len == 0) return;
+  outl(CONSOLE_ADDR_ADDR, (uintptr_t)buf);
+  outl(CONSOLE_LEN_ADDR, len);
+}
+#endif
+
 void halt(int code) {
   nemu_trap(code);
 
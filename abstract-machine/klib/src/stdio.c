@@ -5,6 +5,13 @@
 
 #if !defined(__ISA_NATIVE__) || defined(__NATIVE_USE_KLIB__)
 
+// platforms with a bulk console override it
+__attribute__((weak)) void __am_putbuf(const char *buf, size_t len) {
+  for (size_t i = 0; i < len; i ++) {
+    putch(buf[i]);
+  }
+}
+
 int printf(const char *fmt, ...) {
   char buf[1024];
   va_list args;
@@ -16,9 +23,7 @@ int printf(const char *fmt, ...) {
 
   va_end(args);
 
-  for (int i = 0; i < ret; ++i) {
-    putch(buf[i]);
-  }
+  __am_putbuf(buf, ret);
   return ret;
 
 }
@@ -5,6 +5,7 @@ AM_SRCS := platform/nemu/trm.c \
            platform/nemu/ioe/gpu.c \
            platform/nemu/ioe/audio.c \
            platform/nemu/ioe/disk.c \
+           platform/nemu/ioe/uart.c \
            platform/nemu/mpe.c
 
 CFLAGS    += -fdata-sections -ffunction-sections
@@ -18,6 +19,11 @@ NEMUFLAGS +=  -b
 NEMUFLAGS += -e $(IMAGE).elf
 
 CFLAGS += -DMAINARGS=\"$(mainargs)\"
+### 使用NEMU串口的批量输出扩展, 旧版NEMU没有该扩展时设置NEMU_CONSOLE=0
+NEMU_CONSOLE ?= 1
+ifeq ($(NEMU_CONSOLE),1)
+CFLAGS += -DNEMU_CONSOLE
+endif
 CFLAGS += -I$(AM_HOME)/am/src/platform/nemu/include
 .PHONY: $(AM_HOME)/am/src/platform/nemu/trm.c
 
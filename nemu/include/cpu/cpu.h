@@ -17,15 +17,40 @@
 #define __CPU_CPU_H__
 
 #include <common.h>
+#include <stdatomic.h>
 
 void cpu_exec(uint64_t n);
 
+/* Interrupt sources are latched in `intr_line' by dev_raise_intr(), which
+ * may run in a signal handler or another thread, until the ISA takes them.
+ * `intr_pending' is kept as "intr_line != 0 && the guest enables
+ * interrupts", so the execute loop only loads one flag which stays false
+ * while the guest keeps interrupts off. An ISA with trap support calls
+ * intr_set_enable() whenever its interrupt enable bit changes, and takes
+ * one latched source per isa_query_intr(). None of riscv32, mips32 and
+ * loongarch32r models an interrupt enable yet, so for them the sources
+ * stay latched and `intr_pending' is never set.
+ */
+enum { INTR_SRC_TIMER = 1, INTR_SRC_EXTERNAL = 2 };
+void dev_raise_intr(int src);
+extern atomic_uint intr_line;
+extern atomic_bool intr_enabled, intr_pending;
+void intr_set_enable(bool enable);
+
 void set_nemu_state(int state, vaddr_t pc, int halt_ret);
 void invalid_inst(vaddr_t thispc);
 
-#ifdef CONFIG_FTRACE
-void ftrace_call_print(uint32_t inst_pc, uint32_t inst_des, bool is_tail_call);
-void ftrace_ret_print(uint32_t inst_pc, uint32_t inst_des);
+#ifdef CONFIG_FUNC_HOOK
+// called by the ISA when it recognizes a function call or return
+void trace_func_call(vaddr_t pc, vaddr_t target, bool is_tail_call);
+void trace_func_ret(vaddr_t pc, vaddr_t target);
+#endif
+
+#ifdef CONFIG_BPSIM
+// called by the ISA for conditional branches and jumps
+void bpsim_cond(vaddr_t pc, bool taken);
+void bpsim_jump(vaddr_t pc, vaddr_t target, int rd, int rs1);
+void bpsim_report();
 #endif
 
 #define NEMUTRAP(thispc, code) set_nemu_state(NEMU_END, thispc, code)
@@ -86,12 +86,47 @@ finish:
 }
 
 
+// --- instruction mix ---
+#ifdef CONFIG_INSTMIX
+enum { INSTMIX_OTHER, INSTMIX_LOAD, INSTMIX_STORE, INSTMIX_BRANCH, INSTMIX_JUMP };
+
+typedef struct {
+  const char *name;
+  int class;
+  uint64_t count, taken;
+} InstMix;
+
+#define NR_INSTMIX 256
+extern InstMix instmix[NR_INSTMIX];
+
+/* Every INSTPAT gets a compile-time id from __COUNTER__, so counting it
+ * is an increment at a constant address. The name and the class, given
+ * by INSTPAT_CLASS(name, type) of the ISA, are filled on the first hit.
+ */
+#define INSTMIX_ENTER(id, inst, type, ...) do { \
+  static_assert(id < NR_INSTMIX, "too many INSTPATs for the instruction mix"); \
+  if (unlikely(instmix[id].count ++ == 0)) { \
+    instmix[id].name = #inst; \
+    instmix[id].class = INSTPAT_CLASS(inst, type); \
+  } \
+} while (0)
+#define INSTMIX_LEAVE(s, id) instmix[id].taken += ((s)->dnpc != (s)->snpc)
+
+void instmix_display();
+#else
+#define INSTMIX_ENTER(id, ...)
+#define INSTMIX_LEAVE(s, id)
+#endif
+
 // --- pattern matching wrappers for decode ---
-#define INSTPAT(pattern, ...) do { \
+#define INSTPAT(pattern, ...) __INSTPAT(MUXDEF(CONFIG_INSTMIX, __COUNTER__, 0), pattern, ##__VA_ARGS__)
+#define __INSTPAT(id, pattern, ...) do { \
   uint64_t key, mask, shift; \
   pattern_decode(pattern, STRLEN(pattern), &key, &mask, &shift); \
   if ((((uint64_t)INSTPAT_INST(s) >> shift) & mask) == key) { \
+    INSTMIX_ENTER(id, ##__VA_ARGS__); \
     INSTPAT_MATCH(s, ##__VA_ARGS__); \
+    INSTMIX_LEAVE(s, id); \
     goto *(__instpat_end); \
   } \
 } while (0)
@@ -16,10 +16,13 @@
 #ifndef __CPU_IFETCH_H__
 
 #include <memory/vaddr.h>
+#include <prof.h>
 
 static inline uint32_t inst_fetch(vaddr_t *pc, int len) {
+  IFDEF(CONFIG_SELF_PROF, int prof = prof_enter(PROF_FETCH));
   uint32_t inst = vaddr_ifetch(*pc, len);
   (*pc) += len;
+  IFDEF(CONFIG_SELF_PROF, prof_leave(prof));
   return inst;
 }
 
@@ -21,6 +21,8 @@
 typedef void(*io_callback_t)(uint32_t, int, bool);
 uint8_t* new_space(int size);
 
+typedef struct DtraceStat DtraceStat;
+
 typedef struct {
   const char *name;
   // we treat ioaddr_t as paddr_t here
@@ -28,6 +30,9 @@ typedef struct {
   paddr_t high;
   void *space;
   io_callback_t callback;
+#ifdef CONFIG_DTRACE
+  DtraceStat *stat;
+#endif
 } IOMap;
 
 static inline bool map_inside(IOMap *map, paddr_t addr) {
@@ -53,4 +58,12 @@ void add_mmio_map(const char *name, paddr_t addr,
 word_t map_read(paddr_t addr, int len, IOMap *map);
 void map_write(paddr_t addr, int len, word_t data, IOMap *map);
 
+#ifdef CONFIG_DTRACE
+void init_dtrace();
+uint64_t dtrace_time();
+void dtrace(IOMap *map, paddr_t offset, int len, word_t data, bool is_write, uint64_t cb_ns);
+#else
+static inline void dtrace(IOMap *map, paddr_t offset, int len, word_t data, bool is_write, uint64_t cb_ns) {}
+#endif
+
 #endif
@@ -32,6 +32,8 @@ void init_isa();
 extern CPU_state cpu;
 void isa_reg_display();
 word_t isa_reg_str2val(const char *name, bool *success);
+// return the index of the register in cpu.gpr, or -1
+int isa_reg_str2idx(const char *name);
 
 // exec
 struct Decode;
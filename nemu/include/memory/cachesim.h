@@ -0,0 +1,49 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __MEMORY_CACHESIM_H__
+#define __MEMORY_CACHESIM_H__
+
+#include <isa.h>
+
+#ifdef CONFIG_CACHESIM
+enum { CACHE_IFETCH, CACHE_READ, CACHE_WRITE };
+
+/* Accesses are queued and fed to the cache model in batches, so the
+ * memory access path only pays for a few stores. */
+typedef struct {
+  vaddr_t pc, addr;
+  uint8_t len, type;
+} CacheReq;
+
+#define CACHE_BATCH 4096
+extern CacheReq cache_batch[CACHE_BATCH];
+extern int cache_nr_req;
+
+void init_cachesim();
+void cachesim_flush();
+void cachesim_report();
+
+static inline void cachesim_access(vaddr_t addr, int len, int type) {
+  CacheReq *r = &cache_batch[cache_nr_req ++];
+  r->pc = cpu.pc;
+  r->addr = addr;
+  r->len = len;
+  r->type = type;
+  if (unlikely(cache_nr_req == CACHE_BATCH)) cachesim_flush();
+}
+#endif
+
+#endif
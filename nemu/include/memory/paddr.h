@@ -31,7 +31,35 @@ static inline bool in_pmem(paddr_t addr) {
   return addr - CONFIG_MBASE < CONFIG_MSIZE;
 }
 
+word_t paddr_ifetch(paddr_t addr, int len);
 word_t paddr_read(paddr_t addr, int len);
 void paddr_write(paddr_t addr, int len, word_t data);
 
+#ifdef CONFIG_WATCHPOINT
+/* One bit per page of pmem, set if a data watchpoint may be hit by a write
+ * starting in the page. The watchpoints themselves live in sdb. */
+#define DWATCH_PAGE_SHIFT 12
+extern uint8_t dwatch_page[(CONFIG_MSIZE >> DWATCH_PAGE_SHIFT) / 8 + 1];
+void dwatch_write(paddr_t addr, int len, word_t data);
+
+static inline bool dwatch_test(paddr_t addr) {
+  uint32_t page = (addr - CONFIG_MBASE) >> DWATCH_PAGE_SHIFT;
+  return dwatch_page[page >> 3] & (1 << (page & 7));
+}
+#endif
+
+#ifdef CONFIG_MTRACE
+void init_mtrace();
+void mtrace_flush();
+void mtrace_record(paddr_t addr, int len, word_t data, bool is_write);
+
+/* [mtrace_lo, mtrace_hi] covers all traced addresses, it is emptied
+ * when the instruction window is over */
+extern paddr_t mtrace_lo, mtrace_hi;
+
+static inline void mtrace(paddr_t addr, int len, word_t data, bool is_write) {
+  if (unlikely(addr >= mtrace_lo && addr <= mtrace_hi)) mtrace_record(addr, len, data, is_write);
+}
+#endif
+
 #endif
@@ -0,0 +1,74 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#ifndef __NEMU_PLUGIN_H__
+#define __NEMU_PLUGIN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The C ABI between NEMU and instrumentation plugins.
+ *
+ * A plugin is a shared object loaded with `--plugin=FILE[,ARGS]'. It must
+ * export nemu_plugin_install(), which is called once with the API table of
+ * NEMU and the ARGS string (empty if not given), and returns 0 on success.
+ * The plugin registers callbacks through the table, and NEMU only checks
+ * the events which have callbacks. All addresses and values are passed as
+ * 64-bit integers regardless of the guest.
+ *
+ * Compatible changes only append members to nemu_plugin_api, so a plugin
+ * should check `version' and `size' before using newer members.
+ * This header must not depend on the NEMU configuration.
+ */
+
+#define NEMU_PLUGIN_VERSION 1
+
+#define NEMU_PLUGIN_EXPORT __attribute__((visibility("default")))
+
+// entering a dynamic basic block, i.e. the first instruction, or one following a taken branch or jump
+typedef void (*nemu_plugin_block_cb)(void *udata, uint64_t pc);
+// an instruction has been executed
+typedef void (*nemu_plugin_insn_cb)(void *udata, uint64_t pc, uint32_t inst);
+// a data access to guest memory, instruction fetches are not included
+typedef void (*nemu_plugin_mem_cb)(void *udata, uint64_t pc, uint64_t addr, int len, uint64_t data, bool is_write);
+// an access to a device register, `dev' is the name of the device map
+typedef void (*nemu_plugin_dev_cb)(void *udata, const char *dev, uint64_t pc, uint64_t addr, int len,
+    uint64_t data, bool is_write);
+// the guest program has ended
+typedef void (*nemu_plugin_exit_cb)(void *udata);
+
+typedef struct nemu_plugin_api {
+  uint32_t version;   // NEMU_PLUGIN_VERSION
+  uint32_t size;      // sizeof(nemu_plugin_api)
+  const char *isa;    // name of the guest ISA, such as "riscv32"
+  uint32_t word_size; // size of a guest register in bytes
+
+  void (*register_block_cb)(nemu_plugin_block_cb cb, void *udata);
+  void (*register_insn_cb)(nemu_plugin_insn_cb cb, void *udata);
+  void (*register_mem_cb)(nemu_plugin_mem_cb cb, void *udata);
+  void (*register_dev_cb)(nemu_plugin_dev_cb cb, void *udata);
+  void (*register_exit_cb)(nemu_plugin_exit_cb cb, void *udata);
+
+  // read a guest register by name; `success' may be NULL
+  uint64_t (*read_reg)(const char *name, bool *success);
+  // read guest physical memory without side effects, `len' is 1, 2, 4, or
+  // 8 when word_size is 8; return 0 for other lengths or outside pmem
+  uint64_t (*read_mem)(uint64_t addr, int len);
+} nemu_plugin_api;
+
+NEMU_PLUGIN_EXPORT int nemu_plugin_install(const nemu_plugin_api *api, const char *args);
+
+#endif
@@ -0,0 +1,70 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __PROF_H__
+#define __PROF_H__
+
+#include <common.h>
+
+#ifdef CONFIG_SELF_PROF
+/* Host time of NEMU itself, split into phases. Entering a phase charges
+ * the time since the last switch to the phase being left, so the time of
+ * a phase excludes the phases nested in it, e.g. PROF_EXEC excludes the
+ * memory accesses of the instruction.
+ */
+enum { PROF_OTHER, PROF_FETCH, PROF_EXEC, PROF_MEM, PROF_MMIO, PROF_DEVICE, PROF_TRACE, NR_PROF };
+
+extern uint64_t prof_ticks[NR_PROF], prof_count[NR_PROF], prof_last;
+extern int prof_cur;
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROF_CLOCK "rdtsc"
+static inline uint64_t prof_now() { return __rdtsc(); }
+#else
+#include <time.h>
+#define PROF_CLOCK "clock_gettime"
+static inline uint64_t prof_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#endif
+
+static inline void prof_switch(int id) {
+  uint64_t now = prof_now();
+  prof_ticks[prof_cur] += now - prof_last;
+  prof_last = now;
+  prof_cur = id;
+}
+
+// return the phase being left, which should be passed to prof_leave()
+static inline int prof_enter(int id) {
+  int prev = prof_cur;
+  prof_count[id] ++;
+  prof_switch(id);
+  return prev;
+}
+
+static inline void prof_leave(int prev) { prof_switch(prev); }
+
+// time outside cpu_exec(), such as waiting for sdb commands, is not counted
+static inline void prof_start() { prof_last = prof_now(); prof_cur = PROF_OTHER; }
+static inline void prof_stop() { prof_switch(PROF_OTHER); }
+
+void prof_report(uint64_t host_us);
+#endif
+
+#endif
@@ -0,0 +1,59 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#ifndef __TRACE_DEF_H__
+#define __TRACE_DEF_H__
+
+#include <stdint.h>
+
+/* Binary trace files written by NEMU start with a TraceHeader, followed by
+ * fixed-size records of `rec_size' bytes. All fields are in host byte order.
+ * This header is shared with tools/nemu-trace, so it must not depend on the
+ * NEMU configuration.
+ */
+
+#define TRACE_MAGIC   "NEMUTRC"
+#define TRACE_VERSION 1
+
+enum { TRACE_TYPE_ITRACE, TRACE_TYPE_MTRACE, TRACE_TYPE_DTRACE };
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t type;
+  uint32_t word_size; // size of a guest address in bytes
+  uint32_t rec_size;
+  char triple[32];    // LLVM target triple of the guest
+} TraceHeader;
+
+/* TRACE_TYPE_ITRACE record:
+ *   pc   - `word_size' bytes
+ *   inst - 4 bytes, the (first) instruction word
+ */
+#define ITRACE_REC_SIZE(word_size) ((word_size) + 4)
+
+/* TRACE_TYPE_MTRACE record:
+ *   pc   - `word_size' bytes
+ *   addr - 8 bytes, the physical address
+ *   data - `word_size' bytes, the value read or written
+ *   info - 1 byte, the access size, ORed with MTRACE_WRITE for writes
+ */
+#define MTRACE_REC_SIZE(word_size) (2 * (word_size) + 9)
+#define MTRACE_WRITE 0x80
+
+/* TRACE_TYPE_DTRACE records are laid out as TRACE_TYPE_MTRACE ones */
+
+#endif
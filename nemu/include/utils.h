@@ -20,8 +20,67 @@
 
 // ----------- tracer -----------
 void iring_display();
-void write_iring(char *buf);
-
+void write_iring(vaddr_t pc, uint32_t inst);
+void itrace_format(char *buf, int size, vaddr_t pc, uint8_t *inst, int ilen);
+void init_itrace();
+void itrace_write(vaddr_t pc, uint32_t inst);
+void itrace_flush();
+
+// LLVM target triple used to disassemble guest instructions
+#define DISASM_TRIPLE \
+  MUXDEF(CONFIG_ISA_x86,     "i686", \
+  MUXDEF(CONFIG_ISA_mips32,  "mipsel", \
+  MUXDEF(CONFIG_ISA_riscv, \
+    MUXDEF(CONFIG_RV64,      "riscv64", \
+                             "riscv32"), \
+                             "bad"))) "-pc-linux-gnu"
+
+
+void ftrace_call_print(uint32_t inst_pc, uint32_t inst_des, bool is_tail_call);
+void ftrace_ret_print(uint32_t inst_pc, uint32_t inst_des);
+void callgraph_call(vaddr_t pc, vaddr_t target, bool is_tail_call);
+void callgraph_ret(vaddr_t pc, vaddr_t target);
+void callgraph_report();
+extern uint64_t pcsample_next;
+void pcsample_call(vaddr_t pc, vaddr_t target, bool is_tail_call);
+void pcsample_ret();
+void pcsample(vaddr_t pc);
+void pcsample_report();
+
+// ----------- symtab -----------
+void init_symtab(const char *elf_file);
+// return the name of the function containing `addr', or NULL
+const char *symtab_lookup(vaddr_t addr, vaddr_t *start);
+bool symtab_find_name(const char *name, vaddr_t *addr);
+
+// ----------- trigger -----------
+// `trace_on' gates log_write(), it is flipped by the triggers in trigger.c
+extern bool trace_on, trigger_wr_armed;
+extern uint64_t trigger_next;
+bool trigger_add(const char *action, const char *cond);
+void trigger_add_spec(const char *spec);
+void trigger_clear();
+void trigger_display();
+void trigger_check(vaddr_t pc);
+void trigger_write(paddr_t addr, int len);
+void init_trigger();
+
+// ----------- plugin -----------
+// the events plugins subscribe to, checked before calling into plugin.c
+enum { PLUGIN_EV_EXEC = 1, PLUGIN_EV_MEM = 2, PLUGIN_EV_DEV = 4 };
+extern uint32_t plugin_events;
+void plugin_add(const char *spec);
+void init_plugins();
+void plugin_exit();
+void plugin_insn(vaddr_t pc, uint32_t inst, bool is_jump);
+void plugin_mem(vaddr_t addr, int len, word_t data, bool is_write);
+void plugin_dev(const char *dev, paddr_t addr, int len, word_t data, bool is_write);
+
+// ----------- telemetry -----------
+extern uint64_t telemetry_next, telemetry_mmio, trace_bytes;
+void init_telemetry();
+void telemetry_tick(vaddr_t pc);
+void telemetry_report(vaddr_t pc);
 
 // ----------- state -----------
 
@@ -61,13 +120,13 @@ uint64_t get_time();
 
 #define ANSI_FMT(str, fmt) fmt str ANSI_NONE
 
+void log_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void log_flush();
+
 #define log_write(...) IFDEF(CONFIG_TARGET_NATIVE_ELF, \
   do { \
-    extern FILE* log_fp; \
-    extern bool log_enable(); \
-    if (log_enable()) { \
-      fprintf(log_fp, __VA_ARGS__); \
-      fflush(log_fp); \
+    if (trace_on) { \
+      log_printf(__VA_ARGS__); \
     } \
   } while (0) \
 )
@@ -55,6 +55,8 @@
 #define SDHBCT 0x3c /* Host byte count (debug)         - 32 R/W */
 #define SDDATA 0x40 /* Data to/from SD card            - 32 R/W */
 #define SDHBLC 0x50 /* Host block count (SDIO/SDHC)    -  9 R/W */
+#define SDDMAADDR 0x54 /* DMA buffer address (NEMU)     - 32 R/W */
+#define SDDMACTL  0x58 /* DMA control (NEMU)            -  1 W   */
 
 #define SDCMD_NEW_FLAG			0x8000
 #define SDCMD_FAIL_FLAG			0x4000
@@ -67,6 +69,15 @@
 
 #define SDCDIV_MAX_CDIV			0x7ff
 
+#define SDHSTS_BLOCK_IRPT		0x200
+#define SDHSTS_FIFO_ERROR		0x08
+
+#define SDHSTS_ERROR_MASK		SDHSTS_FIFO_ERROR
+
+#define SDHCFG_BLOCK_IRPT_EN		BIT(8)
+
+#define SDDMACTL_START			0x1
+
 #define SDDATA_FIFO_WORDS	16
 
 #define FIFO_READ_THRESHOLD	4
@@ -90,6 +101,12 @@ struct nemu_host {
 	struct sg_mapping_iter	sg_miter;	/* SG state for PIO */
 	unsigned int		blocks;		/* remaining PIO blocks */
 
+	int			irq;		/* DMA completion irq, or < 0 to poll */
+	bool			use_dma;
+	int			dma_len;	/* mapped SG entries */
+	u32			dma_hsts;	/* SDHSTS seen by the irq handler */
+	struct completion	dma_done;
+
 	struct mmc_request	*mrq;		/* Current request */
 	struct mmc_command	*cmd;		/* Current command */
 	struct mmc_data		*data;		/* Current data request */
@@ -175,6 +192,87 @@ static void nemu_transfer_pio(struct nemu_host *host)
 	nemu_transfer_block_pio(host, is_read);
 }
 
+static void nemu_transfer_dma(struct nemu_host *host)
+{
+	struct device *dev = &host->pdev->dev;
+	struct mmc_data *data = host->data;
+	struct scatterlist *sg;
+	u32 sdhsts;
+	int i;
+
+	writel(data->blksz, host->ioaddr + SDHBCT);
+
+	/* NEMU moves each segment in one go, so there is one
+	 * register setup and one completion per SG entry.
+	 */
+	for_each_sg(data->sg, sg, host->dma_len, i) {
+		if (sg_dma_len(sg) % data->blksz) {
+			data->error = -EINVAL;
+			break;
+		}
+
+		writel(sg_dma_address(sg), host->ioaddr + SDDMAADDR);
+		writel(sg_dma_len(sg) / data->blksz, host->ioaddr + SDHBLC);
+
+		if (host->irq >= 0) {
+			reinit_completion(&host->dma_done);
+			writel(SDDMACTL_START, host->ioaddr + SDDMACTL);
+			if (!wait_for_completion_timeout(&host->dma_done,
+							 msecs_to_jiffies(1000))) {
+				dev_err(dev, "timeout waiting for DMA\n");
+				data->error = -ETIMEDOUT;
+				break;
+			}
+			sdhsts = host->dma_hsts;
+		} else {
+			writel(SDDMACTL_START, host->ioaddr + SDDMACTL);
+			sdhsts = readl(host->ioaddr + SDHSTS);
+			writel(sdhsts, host->ioaddr + SDHSTS);
+		}
+
+		if (sdhsts & SDHSTS_ERROR_MASK) {
+			dev_err(dev, "DMA error - HSTS %08x\n", sdhsts);
+			data->error = -EIO;
+			break;
+		}
+	}
+
+	dma_unmap_sg(dev, data->sg, data->sg_len,
+		     (data->flags & MMC_DATA_READ) ?
+		     DMA_FROM_DEVICE : DMA_TO_DEVICE);
+}
+
+static void nemu_transfer_data(struct nemu_host *host)
+{
+	int i;
+
+	if (host->dma_len) {
+		nemu_transfer_dma(host);
+		return;
+	}
+
+	// start PIO right now
+	for (i = 0; i < host->data->blocks; i ++) {
+		nemu_transfer_pio(host);
+	}
+}
+
+static irqreturn_t nemu_irq(int irq, void *dev_id)
+{
+	struct nemu_host *host = dev_id;
+	u32 sdhsts;
+
+	sdhsts = readl(host->ioaddr + SDHSTS);
+	if (!(sdhsts & (SDHSTS_BLOCK_IRPT | SDHSTS_ERROR_MASK)))
+		return IRQ_NONE;
+
+	writel(sdhsts, host->ioaddr + SDHSTS);
+	host->dma_hsts = sdhsts;
+	complete(&host->dma_done);
+
+	return IRQ_HANDLED;
+}
+
 static
 void nemu_prepare_data(struct nemu_host *host, struct mmc_command *cmd)
 {
@@ -189,6 +287,16 @@ void nemu_prepare_data(struct nemu_host *host, struct mmc_command *cmd)
 
 	host->data_complete = false;
 	host->data->bytes_xfered = 0;
+	host->dma_len = 0;
+
+	if (host->use_dma) {
+		host->dma_len = dma_map_sg(&host->pdev->dev, data->sg, data->sg_len,
+					   (data->flags & MMC_DATA_READ) ?
+					   DMA_FROM_DEVICE : DMA_TO_DEVICE);
+		if (host->dma_len)
+			return;
+		/* fall back to PIO */
+	}
 
   /* Use PIO */
   if (data->flags & MMC_DATA_READ)
@@ -316,11 +424,7 @@ static void nemu_finish_command(struct nemu_host *host)
 		host->cmd = NULL;
 		if (nemu_send_command(host, host->mrq->cmd)) {
 			if (host->data) {
-        // start PIO right now
-        for (i = 0; i < host->data->blocks; i ++) {
-          nemu_transfer_pio(host);
-        }
-
+        nemu_transfer_data(host);
         nemu_finish_data(host);
       }
 
@@ -380,11 +484,7 @@ static void nemu_request(struct mmc_host *mmc, struct mmc_request *mrq)
 		}
 	} else if (mrq->cmd && nemu_send_command(host, mrq->cmd)) {
 		if (host->data) {
-      int i;
-      // start PIO right now
-      for (i = 0; i < host->data->blocks; i ++) {
-        nemu_transfer_pio(host);
-      }
+      nemu_transfer_data(host);
       nemu_finish_data(host);
     }
 
@@ -441,7 +541,9 @@ static int nemu_add_host(struct nemu_host *host)
 		return ret;
 	}
 
-	dev_info(dev, "loaded - DMA %s\n", "disabled");
+	dev_info(dev, "loaded - DMA %s, IRQ %s\n",
+		 host->use_dma ? "enabled" : "disabled",
+		 host->irq >= 0 ? "enabled" : "disabled");
 
 	return 0;
 }
@@ -487,6 +589,21 @@ static int nemu_probe(struct platform_device *pdev)
 
 	host->max_clk = 1000000; //clk_get_rate(clk);
 
+	host->use_dma = !dma_set_mask_and_coherent(dev, DMA_BIT_MASK(32));
+	init_completion(&host->dma_done);
+
+	/* The completion interrupt is optional, poll SDHSTS without it */
+	host->irq = platform_get_irq_optional(pdev, 0);
+	if (host->irq >= 0 && host->use_dma) {
+		ret = devm_request_irq(dev, host->irq, nemu_irq, 0,
+				       mmc_hostname(mmc), host);
+		if (ret)
+			goto err;
+		writel(SDHCFG_BLOCK_IRPT_EN, host->ioaddr + SDHCFG);
+	} else {
+		host->irq = -1;
+	}
+
 	ret = mmc_of_parse(mmc);
 	if (ret)
 		goto err;
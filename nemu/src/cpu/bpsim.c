@@ -0,0 +1,287 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <cpu/cpu.h>
+
+#ifdef CONFIG_BPSIM
+extern uint64_t g_nr_guest_inst;
+
+/* Direction predictors are pluggable: predict() is called for every
+ * conditional branch and followed by update() with the outcome. All of
+ * them run side by side, so one execution evaluates all of them. The
+ * global branch history is shared and shifted after every branch.
+ */
+typedef struct {
+  const char *name;
+  void (*init)();
+  bool (*predict)(vaddr_t pc);
+  void (*update)(vaddr_t pc, bool taken);
+  uint64_t miss;
+} Predictor;
+
+static uint64_t ghr = 0;
+
+static inline void ctr_update(uint8_t *c, bool taken) {
+  if (taken) { if (*c < 3) (*c) ++; }
+  else if (*c > 0) (*c) --;
+}
+
+// --- bimodal: 2-bit counters indexed by pc ---
+#define BIMODAL_MASK ((1u << CONFIG_BP_BIMODAL_BITS) - 1)
+static uint8_t bimodal[BIMODAL_MASK + 1];
+
+static void bimodal_init() { memset(bimodal, 1, sizeof(bimodal)); }
+static bool bimodal_predict(vaddr_t pc) { return bimodal[(pc >> 2) & BIMODAL_MASK] >= 2; }
+static void bimodal_update(vaddr_t pc, bool taken) { ctr_update(&bimodal[(pc >> 2) & BIMODAL_MASK], taken); }
+
+// --- gshare: 2-bit counters indexed by pc xor global history ---
+#define GSHARE_MASK ((1u << CONFIG_BP_GSHARE_BITS) - 1)
+#define GSHARE_IDX(pc) ((((pc) >> 2) ^ ghr) & GSHARE_MASK)
+static uint8_t gshare[GSHARE_MASK + 1];
+
+static void gshare_init() { memset(gshare, 1, sizeof(gshare)); }
+static bool gshare_predict(vaddr_t pc) { return gshare[GSHARE_IDX(pc)] >= 2; }
+static void gshare_update(vaddr_t pc, bool taken) { ctr_update(&gshare[GSHARE_IDX(pc)], taken); }
+
+// --- TAGE-lite: a bimodal base and tagged tables with geometric history lengths ---
+#define TAGE_NR_TABLE 4
+#define TAGE_MASK ((1u << CONFIG_BP_TAGE_BITS) - 1)
+#define TAGE_TAG_BITS 8
+#define TAGE_U_RESET (1u << 18) // age the useful counters every so many branches
+
+typedef struct {
+  uint16_t tag; // 0 means invalid
+  int8_t ctr;   // 3-bit signed counter, taken if >= 0
+  uint8_t u;    // 2-bit useful counter
+} TageEntry;
+
+static const int tage_hlen[TAGE_NR_TABLE] = { 5, 11, 22, 44 };
+static TageEntry tage[TAGE_NR_TABLE][TAGE_MASK + 1];
+static uint8_t tage_base[BIMODAL_MASK + 1];
+static uint64_t tage_tick = 0;
+
+// state of the last prediction, used by the following update
+static struct {
+  uint32_t idx[TAGE_NR_TABLE];
+  uint16_t tag[TAGE_NR_TABLE];
+  int provider, alt;
+  bool pred, alt_pred;
+} tl;
+
+static uint32_t fold(uint64_t h, int len, int bits) {
+  h &= (1ull << len) - 1;
+  uint32_t r = 0;
+  for (; h != 0; h >>= bits) r ^= h & ((1u << bits) - 1);
+  return r;
+}
+
+static void tage_init() { memset(tage_base, 1, sizeof(tage_base)); }
+
+static bool tage_predict(vaddr_t pc) {
+  uint32_t p = pc >> 2;
+  tl.provider = tl.alt = -1;
+  for (int i = TAGE_NR_TABLE - 1; i >= 0; i --) {
+    tl.idx[i] = (p ^ (p >> CONFIG_BP_TAGE_BITS) ^ fold(ghr, tage_hlen[i], CONFIG_BP_TAGE_BITS)) & TAGE_MASK;
+    tl.tag[i] = ((p ^ fold(ghr, tage_hlen[i], TAGE_TAG_BITS) ^ (fold(ghr, tage_hlen[i], TAGE_TAG_BITS - 1) << 1))
+        & ((1u << TAGE_TAG_BITS) - 1)) + 1;
+    if (tage[i][tl.idx[i]].tag == tl.tag[i]) {
+      if (tl.provider == -1) tl.provider = i;
+      else if (tl.alt == -1) tl.alt = i;
+    }
+  }
+  bool base = tage_base[p & BIMODAL_MASK] >= 2;
+  tl.alt_pred = (tl.alt >= 0 ? tage[tl.alt][tl.idx[tl.alt]].ctr >= 0 : base);
+  tl.pred = (tl.provider >= 0 ? tage[tl.provider][tl.idx[tl.provider]].ctr >= 0 : base);
+  return tl.pred;
+}
+
+static void tage_update(vaddr_t pc, bool taken) {
+  if (tl.provider >= 0) {
+    TageEntry *e = &tage[tl.provider][tl.idx[tl.provider]];
+    if (tl.pred != tl.alt_pred) {
+      if (tl.pred == taken) { if (e->u < 3) e->u ++; }
+      else if (e->u > 0) e->u --;
+    }
+    if (taken) { if (e->ctr < 3) e->ctr ++; }
+    else if (e->ctr > -4) e->ctr --;
+  } else {
+    ctr_update(&tage_base[(pc >> 2) & BIMODAL_MASK], taken);
+  }
+
+  // on a misprediction, allocate an entry in a table with a longer history
+  if (tl.pred != taken) {
+    int i;
+    for (i = tl.provider + 1; i < TAGE_NR_TABLE; i ++) {
+      TageEntry *e = &tage[i][tl.idx[i]];
+      if (e->u == 0) {
+        *e = (TageEntry) { .tag = tl.tag[i], .ctr = (taken ? 0 : -1), .u = 0 };
+        break;
+      }
+    }
+    if (i == TAGE_NR_TABLE) {
+      for (i = tl.provider + 1; i < TAGE_NR_TABLE; i ++) tage[i][tl.idx[i]].u --;
+    }
+  }
+
+  if (++ tage_tick % TAGE_U_RESET == 0) {
+    for (int i = 0; i < TAGE_NR_TABLE; i ++) {
+      for (int j = 0; j <= TAGE_MASK; j ++) tage[i][j].u >>= 1;
+    }
+  }
+}
+
+static Predictor preds[] = {
+  { "bimodal",   bimodal_init, bimodal_predict, bimodal_update },
+  { "gshare",    gshare_init,  gshare_predict,  gshare_update },
+  { "tage-lite", tage_init,    tage_predict,    tage_update },
+};
+#define NR_PRED ARRLEN(preds)
+
+// --- per-branch statistics, an open addressing hash table keyed by pc ---
+typedef struct {
+  vaddr_t pc;
+  uint64_t count, taken, miss[NR_PRED];
+} BranchStat;
+
+static BranchStat *branches = NULL;
+static uint32_t nr_branch = 0, cap_branch = 0;
+static uint64_t nr_cond = 0, nr_taken = 0;
+
+static BranchStat *branch_of(vaddr_t pc);
+
+static void branch_grow() {
+  BranchStat *old = branches;
+  uint32_t old_cap = cap_branch;
+  cap_branch = old_cap ? old_cap * 2 : 4096;
+  branches = calloc(cap_branch, sizeof(branches[0]));
+  Assert(branches, "out of memory");
+  nr_branch = 0;
+  for (uint32_t i = 0; i < old_cap; i ++) {
+    if (old[i].count != 0) *branch_of(old[i].pc) = old[i];
+  }
+  free(old);
+}
+
+static BranchStat *branch_of(vaddr_t pc) {
+  uint32_t i = ((pc >> 2) * 0x9e3779b1u) & (cap_branch - 1);
+  for (; branches[i].count != 0; i = (i + 1) & (cap_branch - 1)) {
+    if (branches[i].pc == pc) return &branches[i];
+  }
+  if (2 * (nr_branch + 1) > cap_branch) {
+    branch_grow();
+    return branch_of(pc);
+  }
+  nr_branch ++;
+  branches[i].pc = pc;
+  return &branches[i];
+}
+
+void bpsim_cond(vaddr_t pc, bool taken) {
+  BranchStat *b = branch_of(pc);
+  b->count ++;
+  b->taken += taken;
+  nr_cond ++;
+  nr_taken += taken;
+  for (int i = 0; i < NR_PRED; i ++) {
+    Predictor *p = &preds[i];
+    if (p->predict(pc) != taken) {
+      p->miss ++;
+      b->miss[i] ++;
+    }
+    p->update(pc, taken);
+  }
+  ghr = (ghr << 1) | taken;
+}
+
+// --- return address stack, following the hints of the RISC-V spec ---
+#define IS_LINK(r) ((r) == 1 || (r) == 5)
+
+static vaddr_t ras[CONFIG_BP_RAS_SIZE];
+static int ras_top = 0, ras_nr = 0; // the oldest entries are overwritten
+static uint64_t nr_ret = 0, ras_miss = 0;
+
+void bpsim_jump(vaddr_t pc, vaddr_t target, int rd, int rs1) {
+  bool push = IS_LINK(rd);
+  bool pop = rs1 >= 0 && IS_LINK(rs1) && !(push && rd == rs1);
+  if (pop) {
+    nr_ret ++;
+    if (ras_nr == 0) ras_miss ++;
+    else {
+      ras_top = (ras_top + CONFIG_BP_RAS_SIZE - 1) % CONFIG_BP_RAS_SIZE;
+      ras_nr --;
+      if (ras[ras_top] != target) ras_miss ++;
+    }
+  }
+  if (push) {
+    ras[ras_top] = pc + 4;
+    ras_top = (ras_top + 1) % CONFIG_BP_RAS_SIZE;
+    if (ras_nr < CONFIG_BP_RAS_SIZE) ras_nr ++;
+  }
+}
+
+// --- report ---
+#define NR_WORST 10
+
+static int cmp_branch(const void *a, const void *b) {
+  const BranchStat *x = *(BranchStat * const *)a, *y = *(BranchStat * const *)b;
+  uint64_t mx = 0, my = 0;
+  for (int i = 0; i < NR_PRED; i ++) { mx += x->miss[i]; my += y->miss[i]; }
+  return (mx < my) - (mx > my);
+}
+
+static double mpki(uint64_t miss) {
+  return g_nr_guest_inst ? 1000.0 * miss / g_nr_guest_inst : 0;
+}
+
+void bpsim_report() {
+  if (nr_cond == 0 && nr_ret == 0) return;
+  _Log("branch predictors: %" PRIu64 " conditional branches (%.2f%% taken), %" PRIu64 " returns\n",
+      nr_cond, nr_cond ? 100.0 * nr_taken / nr_cond : 0, nr_ret);
+  _Log("%-12s %16s %10s %10s\n", "predictor", "mispredicts", "accuracy%", "MPKI");
+  for (int i = 0; i < NR_PRED; i ++) {
+    _Log("%-12s %16" PRIu64 " %10.2f %10.3f\n", preds[i].name, preds[i].miss,
+        nr_cond ? 100.0 - 100.0 * preds[i].miss / nr_cond : 0, mpki(preds[i].miss));
+  }
+  _Log("%-12s %16" PRIu64 " %10.2f %10.3f\n", "ras", ras_miss,
+      nr_ret ? 100.0 - 100.0 * ras_miss / nr_ret : 0, mpki(ras_miss));
+
+  BranchStat **sorted = malloc(sizeof(sorted[0]) * (nr_branch + 1));
+  int n = 0;
+  for (uint32_t i = 0; i < cap_branch; i ++) {
+    if (branches[i].count != 0) sorted[n ++] = &branches[i];
+  }
+  qsort(sorted, n, sizeof(sorted[0]), cmp_branch);
+  _Log("worst-predicted branches:\n");
+  char hdr[128], *p = hdr;
+  for (int i = 0; i < NR_PRED; i ++) p += sprintf(p, " %12s", preds[i].name);
+  _Log("%-10s %-20s %14s %8s%s\n", "pc", "function", "count", "taken%", hdr);
+  for (int i = 0; i < n && i < NR_WORST; i ++) {
+    BranchStat *b = sorted[i];
+    const char *name = symtab_lookup(b->pc, NULL);
+    char miss[128];
+    p = miss;
+    for (int j = 0; j < NR_PRED; j ++) p += sprintf(p, " %12" PRIu64, b->miss[j]);
+    _Log(FMT_WORD " %-20s %14" PRIu64 " %8.2f%s\n", b->pc, name ? name : "???", b->count,
+        100.0 * b->taken / b->count, miss);
+  }
+  free(sorted);
+}
+
+void init_bpsim() {
+  for (int i = 0; i < NR_PRED; i ++) preds[i].init();
+  branch_grow();
+}
+#endif
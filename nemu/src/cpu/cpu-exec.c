@@ -16,6 +16,9 @@
 #include <cpu/cpu.h>
 #include <cpu/decode.h>
 #include <cpu/difftest.h>
+#include <memory/paddr.h>
+#include <memory/cachesim.h>
+#include <prof.h>
 #include <locale.h>
 #include "../monitor/sdb/sdb.h"
 
@@ -27,64 +30,91 @@
 #define MAX_INST_TO_PRINT 10
 
 CPU_state cpu = {};
+atomic_uint intr_line = 0;
+atomic_bool intr_enabled = false, intr_pending = false;
 uint64_t g_nr_guest_inst = 0;
 static uint64_t g_timer = 0; // unit: us
 static bool g_print_step = false;
 
 void device_update();
+void serial_flush();
+void dtrace_flush();
+void dtrace_report();
+
+#ifdef CONFIG_ITRACE
+/* Disassembling is expensive, so the text of an instruction is only
+ * produced when somebody is going to read it.
+ */
+static void format_logbuf(Decode *s) {
+  itrace_format(s->logbuf, sizeof(s->logbuf), s->pc,
+      (uint8_t *)&s->isa.inst.val, s->snpc - s->pc);
+}
+#endif
 
 static void trace_and_difftest(Decode *_this, vaddr_t dnpc) {
+  IFDEF(CONFIG_ITRACE, _this->logbuf[0] = '\0');
 #ifdef CONFIG_ITRACE_COND
   if (ITRACE_COND) {
-    log_write("%s\n", _this->logbuf);
-    write_iring(_this->logbuf); // [待定]未规定指令记录时机
+    if (trace_on) {
+#ifdef CONFIG_ITRACE_BINARY
+      itrace_write(_this->pc, _this->isa.inst.val);
+#else
+      format_logbuf(_this);
+      log_write("%s\n", _this->logbuf);
+#endif
+    }
+    write_iring(_this->pc, _this->isa.inst.val); // [待定]未规定指令记录时机
   }
 #endif
-  if (g_print_step) { IFDEF(CONFIG_ITRACE, puts(_this->logbuf)); }
+  if (g_print_step) {
+#ifdef CONFIG_ITRACE
+    if (_this->logbuf[0] == '\0') format_logbuf(_this);
+    puts(_this->logbuf);
+#endif
+  }
   IFDEF(CONFIG_DIFFTEST, difftest_step(_this->pc, dnpc));
 
 #ifdef CONFIG_WATCHPOINT
   if (check_watchpoint()) {
     printf("\e[1;36m");  // 设置文本颜色为青色并加粗
     printf("Stop at:\n"); 
+#ifdef CONFIG_ITRACE
+    if (_this->logbuf[0] == '\0') format_logbuf(_this);
     puts(_this->logbuf);
+#endif
     printf("\e[0m");  // 重置文本样式
     nemu_state.state = NEMU_STOP;
   }
 #endif
+  // stop before the instruction at a breakpoint is executed
+  IFDEF(CONFIG_BREAKPOINT, if (unlikely(nr_breakpoint > 0) && breakpoint_hit(dnpc)) nemu_state.state = NEMU_STOP);
 }
 
 /* 让CPU执行当前PC指向的一条指令, 然后更新PC. */
 static void exec_once(Decode *s, vaddr_t pc) {
   s->pc = pc;
   s->snpc = pc;
+  IFDEF(CONFIG_SELF_PROF, int prof = prof_enter(PROF_EXEC));
   isa_exec_once(s);
+  IFDEF(CONFIG_SELF_PROF, prof_leave(prof));
   cpu.pc = s->dnpc;
-#ifdef CONFIG_ITRACE
-  char *p = s->logbuf;
-  p += snprintf(p, sizeof(s->logbuf), FMT_WORD ":", s->pc);
-  int ilen = s->snpc - s->pc;
-  int i;
-  uint8_t *inst = (uint8_t *)&s->isa.inst.val;
-  for (i = ilen - 1; i >= 0; i --) {
-    p += snprintf(p, 4, " %02x", inst[i]); // si 单步调试中的一条指令的内容。
+}
+
+/* Clearing `intr_pending' before looking at `intr_line' pairs with the
+ * store order in dev_raise_intr(), so a source raised meanwhile is not lost.
+ */
+void intr_set_enable(bool enable) {
+  atomic_store(&intr_enabled, enable);
+  atomic_store(&intr_pending, false);
+  if (enable && atomic_load(&intr_line) != 0) atomic_store(&intr_pending, true);
+}
+
+static void check_intr() {
+  word_t intr = isa_query_intr();
+  if (intr != INTR_EMPTY) {
+    IFDEF(CONFIG_DIFFTEST, ref_difftest_raise_intr(intr));
+    cpu.pc = isa_raise_intr(intr, cpu.pc);
   }
-  int ilen_max = MUXDEF(CONFIG_ISA_x86, 8, 4);
-  int space_len = ilen_max - ilen;
-  if (space_len < 0) space_len = 0;
-  space_len = space_len * 3 + 1;
-  memset(p, ' ', space_len);
-  p += space_len;
-
-#ifndef CONFIG_ISA_loongarch32r
-  // s反汇编，打印 si 二进制指令对应的汇编指令。
-  void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte);
-  disassemble(p, s->logbuf + sizeof(s->logbuf) - p,
-      MUXDEF(CONFIG_ISA_x86, s->snpc, s->pc), (uint8_t *)&s->isa.inst.val, ilen);
-#else
-  p[0] = '\0'; // the upstream llvm does not support loongarch32r
-#endif
-#endif
 }
 
 static void execute(uint64_t n) {
@@ -92,9 +122,24 @@ static void execute(uint64_t n) {
   for (;n > 0; n --) {
     exec_once(&s, cpu.pc);
     g_nr_guest_inst ++;
+    IFDEF(CONFIG_TRACE_TRIGGER, if (unlikely(g_nr_guest_inst >= trigger_next)) trigger_check(s.pc));
+    IFDEF(CONFIG_SELF_PROF, int prof = prof_enter(PROF_TRACE));
+    IFDEF(CONFIG_PLUGIN, if (unlikely(plugin_events & PLUGIN_EV_EXEC))
+        plugin_insn(s.pc, s.isa.inst.val, s.dnpc != s.snpc));
+    IFDEF(CONFIG_PCSAMPLE, if (unlikely(g_nr_guest_inst >= pcsample_next)) pcsample(cpu.pc));
+    IFDEF(CONFIG_TELEMETRY, if (unlikely(g_nr_guest_inst >= telemetry_next)) telemetry_tick(s.pc));
     trace_and_difftest(&s, cpu.pc);
+    IFDEF(CONFIG_SELF_PROF, prof_leave(prof));
     if (nemu_state.state != NEMU_RUNNING) break;
+#if defined(CONFIG_DEVICE) && defined(CONFIG_SELF_PROF)
+    prof = prof_enter(PROF_DEVICE);
+    device_update();
+    prof_leave(prof);
+#else
     IFDEF(CONFIG_DEVICE, device_update());
+#endif
+    // only one load per instruction unless an interrupt is pending
+    if (unlikely(atomic_load_explicit(&intr_pending, memory_order_relaxed))) check_intr();
   }
 }
 
@@ -105,14 +150,28 @@ static void statistic() {
   Log("total guest instructions = " NUMBERIC_FMT, g_nr_guest_inst);
   if (g_timer > 0) Log("simulation frequency = " NUMBERIC_FMT " inst/s", g_nr_guest_inst * 1000000 / g_timer);
   else Log("Finish running in less than 1 us and can not calculate the simulation frequency");
+  IFDEF(CONFIG_TELEMETRY, telemetry_report(cpu.pc));
+  IFDEF(CONFIG_SELF_PROF, prof_report(g_timer));
+  IFDEF(CONFIG_INSTMIX, instmix_display());
+  IFDEF(CONFIG_CALLGRAPH, callgraph_report());
+  IFDEF(CONFIG_PCSAMPLE, pcsample_report());
+  IFDEF(CONFIG_CACHESIM, cachesim_report());
+  IFDEF(CONFIG_BPSIM, bpsim_report());
+  IFDEF(CONFIG_PLUGIN, plugin_exit());
+  IFDEF(CONFIG_DTRACE, dtrace_report());
 }
 
 void assert_fail_msg() {
+  IFDEF(CONFIG_HAS_SERIAL, serial_flush());
+  IFDEF(CONFIG_ITRACE_BINARY, itrace_flush());
+  IFDEF(CONFIG_MTRACE, mtrace_flush());
+  IFDEF(CONFIG_DTRACE, dtrace_flush());
   isa_reg_display();
 #ifdef CONFIG_ITRACE_COND
   iring_display(); // [待定]未规定iring输出时机
 #endif
   statistic();
+  IFNDEF(CONFIG_TARGET_AM, log_flush());
 }
 
 /* Simulate how the CPU works. */
@@ -127,7 +186,10 @@ void cpu_exec(uint64_t n) {
 
   uint64_t timer_start = get_time();
 
+  IFDEF(CONFIG_SELF_PROF, prof_start());
   execute(n);
+  IFDEF(CONFIG_SELF_PROF, prof_stop());
+  IFDEF(CONFIG_HAS_SERIAL, serial_flush());
 
   uint64_t timer_end = get_time();
   g_timer += timer_end - timer_start;
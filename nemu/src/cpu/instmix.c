@@ -0,0 +1,67 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <cpu/decode.h>
+
+#ifdef CONFIG_INSTMIX
+InstMix instmix[NR_INSTMIX] = {};
+
+static int cmp_count(const void *a, const void *b) {
+  const InstMix *x = *(InstMix * const *)a, *y = *(InstMix * const *)b;
+  return (x->count < y->count) - (x->count > y->count);
+}
+
+static double percent(uint64_t x, uint64_t total) {
+  return total ? 100.0 * x / total : 0;
+}
+
+void instmix_display() {
+  static const char *class_name[] = {
+    [INSTMIX_OTHER] = "other", [INSTMIX_LOAD] = "load", [INSTMIX_STORE] = "store",
+    [INSTMIX_BRANCH] = "branch", [INSTMIX_JUMP] = "jump",
+  };
+  InstMix *sorted[NR_INSTMIX];
+  uint64_t class_count[ARRLEN(class_name)] = {}, class_taken[ARRLEN(class_name)] = {};
+  uint64_t total = 0;
+  int n = 0;
+  for (int i = 0; i < NR_INSTMIX; i ++) {
+    InstMix *m = &instmix[i];
+    if (m->count == 0) continue;
+    sorted[n ++] = m;
+    total += m->count;
+    class_count[m->class] += m->count;
+    class_taken[m->class] += m->taken;
+  }
+  qsort(sorted, n, sizeof(sorted[0]), cmp_count);
+
+  _Log("instruction mix of %" PRIu64 " instructions:\n", total);
+  _Log("%-10s %-8s %16s %8s %8s\n", "inst", "class", "count", "%", "taken%");
+  for (int i = 0; i < n; i ++) {
+    InstMix *m = sorted[i];
+    char taken[16] = "";
+    if (m->class == INSTMIX_BRANCH) snprintf(taken, sizeof(taken), "%8.2f", percent(m->taken, m->count));
+    _Log("%-10s %-8s %16" PRIu64 " %8.2f %s\n", m->name, class_name[m->class], m->count,
+        percent(m->count, total), taken);
+  }
+  _Log("%-10s %-8s %16s %8s %8s\n", "", "class", "count", "%", "taken%");
+  for (int i = 0; i < ARRLEN(class_name); i ++) {
+    char taken[16] = "";
+    if (i == INSTMIX_BRANCH) snprintf(taken, sizeof(taken), "%8.2f", percent(class_taken[i], class_count[i]));
+    _Log("%-10s %-8s %16" PRIu64 " %8.2f %s\n", "", class_name[i], class_count[i],
+        percent(class_count[i], total), taken);
+  }
+}
+#endif
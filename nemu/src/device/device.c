@@ -18,6 +18,8 @@
 #include <device/alarm.h>
 #ifndef CONFIG_TARGET_AM
 #include <SDL2/SDL.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #endif
 
 void init_map();
@@ -31,7 +33,52 @@ void init_sdcard();
 void init_alarm();
 
 void send_key(uint8_t, bool);
+void key_queue_clear();
+void vga_init_screen();
 void vga_update_screen();
+void vga_present_screen();
+void serial_flush();
+
+#ifndef CONFIG_TARGET_AM
+/* All SDL video and event handling runs on this thread, since SDL wants
+ * events to be pumped by the thread which created the window. The CPU
+ * thread only sees the key queue and `sdl_quit', and hands synced frames
+ * over in vga_update_screen().
+ */
+static atomic_bool sdl_quit = false;
+
+static void sdl_handle_event(SDL_Event *event) {
+  switch (event->type) {
+    case SDL_QUIT:
+      atomic_store_explicit(&sdl_quit, true, memory_order_relaxed);
+      break;
+#ifdef CONFIG_HAS_KEYBOARD
+    // If a key was pressed
+    case SDL_KEYDOWN:
+    case SDL_KEYUP: {
+      uint8_t k = event->key.keysym.scancode;
+      bool is_keydown = (event->key.type == SDL_KEYDOWN);
+      send_key(k, is_keydown);
+      break;
+    }
+#endif
+    default: break;
+  }
+}
+
+static void *sdl_thread(void *arg) {
+  SDL_InitSubSystem(SDL_INIT_EVENTS);
+  IFDEF(CONFIG_HAS_VGA, vga_init_screen());
+  while (true) {
+    SDL_Event event;
+    if (SDL_WaitEventTimeout(&event, 1000 / TIMER_HZ)) {
+      do { sdl_handle_event(&event); } while (SDL_PollEvent(&event));
+    }
+    IFDEF(CONFIG_VGA_SHOW_SCREEN, vga_present_screen());
+  }
+  return NULL;
+}
+#endif
 
 void device_update() {
   static uint64_t last = 0;
@@ -41,35 +88,18 @@ void device_update() {
   }
   last = now;
 
+  IFDEF(CONFIG_HAS_SERIAL, serial_flush());
   IFDEF(CONFIG_HAS_VGA, vga_update_screen());
-
 #ifndef CONFIG_TARGET_AM
-  SDL_Event event;
-  while (SDL_PollEvent(&event)) {
-    switch (event.type) {
-      case SDL_QUIT:
-        nemu_state.state = NEMU_QUIT;
-        break;
-#ifdef CONFIG_HAS_KEYBOARD
-      // If a key was pressed
-      case SDL_KEYDOWN:
-      case SDL_KEYUP: {
-        uint8_t k = event.key.keysym.scancode;
-        bool is_keydown = (event.key.type == SDL_KEYDOWN);
-        send_key(k, is_keydown);
-        break;
-      }
-#endif
-      default: break;
-    }
+  if (atomic_load_explicit(&sdl_quit, memory_order_relaxed)) {
+    nemu_state.state = NEMU_QUIT;
   }
 #endif
 }
 
 void sdl_clear_event_queue() {
-#ifndef CONFIG_TARGET_AM
-  SDL_Event event;
-  while (SDL_PollEvent(&event));
+#if defined(CONFIG_HAS_KEYBOARD) && !defined(CONFIG_TARGET_AM)
+  key_queue_clear();
 #endif
 }
 
@@ -86,4 +116,9 @@ void init_device() {
   IFDEF(CONFIG_HAS_SDCARD, init_sdcard());
 
   IFNDEF(CONFIG_TARGET_AM, init_alarm());
+
+#ifndef CONFIG_TARGET_AM
+  pthread_t tid;
+  Assert(pthread_create(&tid, NULL, sdl_thread, NULL) == 0, "Can not create the SDL thread");
+#endif
 }
@@ -13,7 +13,169 @@
 * See the Mulan PSL v2 for more details.
 ***************************************************************************************/
 
+
+#include <common.h>
 #include <device/map.h>
+#include <memory/paddr.h>
+#include <cpu/cpu.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* A block device fed by a command queue in guest memory.
+ *
+ * The guest sets up a ring of `reg_qsize' descriptors at `reg_queue', fills
+ * the descriptor at index `head', and then writes `head + 1' to `reg_head'.
+ * A worker thread carries out the transfers with pread()/pwrite() directly
+ * on guest memory, so the CPU keeps running while the host does the I/O.
+ * When a command finishes, the worker sets DISK_CMD_DONE in its `cmd' word,
+ * advances `reg_tail' and raises an interrupt if `reg_intr' is set. The
+ * guest may either poll the descriptor (no MMIO trap needed) or the
+ * `reg_tail' register, or wait for the interrupt.
+ *
+ * Indices are free-running 32-bit counters; descriptor i lives at slot
+ * i % reg_qsize, and reg_qsize must be a power of 2.
+ */
+
+#define DISK_BLKSZ 512
+
+#define DISK_CMD_WRITE 0x1
+#define DISK_CMD_ERROR 0x40000000
+#define DISK_CMD_DONE  0x80000000
+
+enum {
+  reg_present,
+  reg_blksz,
+  reg_blkcnt,
+  reg_queue,
+  reg_qsize,
+  reg_head,
+  reg_tail,
+  reg_intr,
+  nr_reg
+};
+
+typedef struct {
+  uint32_t blkno;
+  uint32_t blkcnt;
+  uint32_t buf;
+  uint32_t cmd;
+} DiskDesc;
+
+static uint32_t *disk_base = NULL;
+static int disk_fd = -1;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  cond = PTHREAD_COND_INITIALIZER;
+// protected by `lock'
+static uint32_t queue = 0, qsize = 0, head = 0;
+static bool intr_en = false;
+// written by the worker, read by the CPU thread
+static _Atomic uint32_t tail = 0;
+
+static bool xfer(bool is_write, uint8_t *buf, size_t len, off_t off) {
+  while (len > 0) {
+    ssize_t ret = is_write ? pwrite(disk_fd, buf, len, off) : pread(disk_fd, buf, len, off);
+    if (ret < 0) return false;
+    if (ret == 0) {
+      // reading past EOF of a sparse image
+      if (is_write) return false;
+      memset(buf, 0, len);
+      return true;
+    }
+    buf += ret; off += ret; len -= ret;
+  }
+  return true;
+}
+
+static void disk_do_cmd(DiskDesc *d) {
+  uint32_t cmd = d->cmd;
+  uint32_t blkcnt = d->blkcnt;
+  uint64_t len = (uint64_t)blkcnt * DISK_BLKSZ;
+  bool ok = (uint64_t)d->blkno + blkcnt <= disk_base[reg_blkcnt] &&
+    len <= CONFIG_MSIZE && in_pmem(d->buf) && (len == 0 || in_pmem(d->buf + len - 1));
+  if (ok) {
+    ok = xfer(cmd & DISK_CMD_WRITE, guest_to_host(d->buf), len, (off_t)d->blkno * DISK_BLKSZ);
+  }
+  // make the data visible before the guest can observe the done bit
+  atomic_store_explicit((_Atomic uint32_t *)&d->cmd,
+      cmd | DISK_CMD_DONE | (ok ? 0 : DISK_CMD_ERROR), memory_order_release);
+}
+
+static void *disk_worker(void *arg) {
+  uint32_t t = 0;
+  pthread_mutex_lock(&lock);
+  while (true) {
+    while (t == head) pthread_cond_wait(&cond, &lock);
+    uint32_t q = queue, size = qsize, h = head;
+    pthread_mutex_unlock(&lock);
+
+    for (; t != h; t ++) {
+      paddr_t addr = q + (t & (size - 1)) * sizeof(DiskDesc);
+      if (size != 0 && in_pmem(addr) && in_pmem(addr + sizeof(DiskDesc) - 1)) {
+        disk_do_cmd((DiskDesc *)guest_to_host(addr));
+      }
+      atomic_store_explicit(&tail, t + 1, memory_order_release);
+    }
+
+    pthread_mutex_lock(&lock);
+    if (intr_en) dev_raise_intr(INTR_SRC_EXTERNAL);
+  }
+  return NULL;
+}
+
+static void disk_io_handler(uint32_t offset, int len, bool is_write) {
+  assert(len == 4);
+  switch (offset / 4) {
+    case reg_queue: case reg_qsize: case reg_head: case reg_intr:
+      if (!is_write) break;
+      // refuse the command until the guest sets up a valid queue
+      if ((disk_base[reg_qsize] & (disk_base[reg_qsize] - 1)) != 0) {
+        Log("disk: queue size %u is not a power of 2, command ignored", disk_base[reg_qsize]);
+        break;
+      }
+      pthread_mutex_lock(&lock);
+      queue = disk_base[reg_queue];
+      qsize = disk_base[reg_qsize];
+      intr_en = disk_base[reg_intr];
+      if (offset / 4 == reg_head && head != disk_base[reg_head]) {
+        head = disk_base[reg_head];
+        pthread_cond_signal(&cond);
+      }
+      pthread_mutex_unlock(&lock);
+      break;
+    case reg_tail:
+      if (!is_write) disk_base[reg_tail] = atomic_load_explicit(&tail, memory_order_acquire);
+      break;
+    default: break;
+  }
+}
 
 void init_disk() {
+  uint32_t space_size = sizeof(uint32_t) * nr_reg;
+  disk_base = (uint32_t *)new_space(space_size);
+  disk_base[reg_blksz] = DISK_BLKSZ;
+#ifdef CONFIG_HAS_PORT_IO
+  add_pio_map ("disk", CONFIG_DISK_CTL_PORT, disk_base, space_size, disk_io_handler);
+#else
+  add_mmio_map("disk", CONFIG_DISK_CTL_MMIO, disk_base, space_size, disk_io_handler);
+#endif
+
+  const char *path = CONFIG_DISK_IMG_PATH;
+  if (path[0] == '\0') return;
+  disk_fd = open(path, O_RDWR);
+  if (disk_fd < 0) {
+    Log("Can not open disk image '%s', disk is not present", path);
+    return;
+  }
+  struct stat st;
+  Assert(fstat(disk_fd, &st) == 0, "Can not stat disk image '%s'", path);
+  disk_base[reg_blkcnt] = st.st_size / DISK_BLKSZ;
+
+  pthread_t tid;
+  Assert(pthread_create(&tid, NULL, disk_worker, NULL) == 0, "Can not create the disk worker thread");
+  disk_base[reg_present] = 1;
+  Log("Disk image '%s' with %u blocks", path, disk_base[reg_blkcnt]);
 }
@@ -14,6 +14,13 @@
 ***************************************************************************************/
 
 #include <isa.h>
+#include <cpu/cpu.h>
 
-void dev_raise_intr() {
+/* Latch the interrupt of `src' (INTR_SRC_*). This is safe to call from
+ * signal handlers and device threads. `intr_pending' is only set when the
+ * guest enables interrupts, see intr_set_enable().
+ */
+void dev_raise_intr(int src) {
+  atomic_fetch_or(&intr_line, src);
+  if (atomic_load(&intr_enabled)) atomic_store(&intr_pending, true);
 }
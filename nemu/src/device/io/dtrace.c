@@ -0,0 +1,154 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <isa.h>
+#include <device/map.h>
+
+#ifdef CONFIG_DTRACE
+#include <time.h>
+#include <trace-def.h>
+
+/* Offsets below NR_REG are counted one by one, larger offsets of a map
+ * (frame buffers and the like) are only counted as a whole. */
+#define NR_REG    256
+#define NR_BUCKET 32
+#define NR_STAT   32
+
+typedef struct {
+  uint64_t nr_read, nr_write;
+} Count;
+
+struct DtraceStat {
+  IOMap *map;
+  Count total, reg[NR_REG];
+  uint64_t cb_ns;
+  uint64_t hist[NR_BUCKET]; // hist[i] counts callbacks taking [2^(i-1), 2^i) ns
+};
+
+static DtraceStat *stats[NR_STAT];
+static int nr_stat = 0;
+
+uint64_t dtrace_time() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#define REC_SIZE MTRACE_REC_SIZE(sizeof(word_t))
+#define BUF_SIZE (1024 * 1024 / REC_SIZE * REC_SIZE)
+
+static uint8_t buf[BUF_SIZE];
+static size_t len = 0;
+static FILE *fp = NULL;
+
+void dtrace_flush() {
+  if (fp != NULL && len > 0) {
+    fwrite(buf, 1, len, fp);
+    IFDEF(CONFIG_TELEMETRY, trace_bytes += len);
+    fflush(fp);
+    len = 0;
+  }
+}
+
+static void dtrace_log(paddr_t addr, int size, word_t data, bool is_write) {
+  if (unlikely(len == BUF_SIZE)) dtrace_flush();
+  uint8_t *p = buf + len;
+  uint64_t addr64 = addr;
+  uint8_t info = size | (is_write ? MTRACE_WRITE : 0);
+  memcpy(p, &cpu.pc, sizeof(word_t)); p += sizeof(word_t);
+  memcpy(p, &addr64, sizeof(addr64)); p += sizeof(addr64);
+  memcpy(p, &data, sizeof(word_t)); p += sizeof(word_t);
+  *p = info;
+  len += REC_SIZE;
+}
+
+void dtrace(IOMap *map, paddr_t offset, int size, word_t data, bool is_write, uint64_t cb_ns) {
+  DtraceStat *s = map->stat;
+  if (unlikely(s == NULL)) {
+    Assert(nr_stat < NR_STAT, "too many maps for DTRACE");
+    s = map->stat = calloc(1, sizeof(*s));
+    Assert(s, "out of memory");
+    s->map = map;
+    stats[nr_stat ++] = s;
+  }
+  if (is_write) s->total.nr_write ++; else s->total.nr_read ++;
+  if (offset < NR_REG) {
+    if (is_write) s->reg[offset].nr_write ++; else s->reg[offset].nr_read ++;
+  }
+  if (map->callback != NULL) {
+    s->cb_ns += cb_ns;
+    int b = (cb_ns == 0 ? 0 : 64 - __builtin_clzll(cb_ns));
+    s->hist[b < NR_BUCKET ? b : NR_BUCKET - 1] ++;
+  }
+  if (fp != NULL) dtrace_log(map->low + offset, size, data, is_write);
+}
+
+static int cmp_stat(const void *a, const void *b) {
+  const DtraceStat *x = *(DtraceStat * const *)a, *y = *(DtraceStat * const *)b;
+  uint64_t nx = x->total.nr_read + x->total.nr_write, ny = y->total.nr_read + y->total.nr_write;
+  return (nx < ny) - (nx > ny);
+}
+
+void dtrace_report() {
+  if (nr_stat == 0) return;
+  qsort(stats, nr_stat, sizeof(stats[0]), cmp_stat);
+  _Log("device access summary:\n");
+  _Log("%-18s %14s %14s %14s %10s\n", "map / offset", "reads", "writes", "callback (us)", "avg (ns)");
+  for (int i = 0; i < nr_stat; i ++) {
+    DtraceStat *s = stats[i];
+    uint64_t n = s->total.nr_read + s->total.nr_write;
+    _Log("%-18s %14" PRIu64 " %14" PRIu64 " %14" PRIu64 " %10" PRIu64 "\n", s->map->name,
+        s->total.nr_read, s->total.nr_write, s->cb_ns / 1000, n ? s->cb_ns / n : 0);
+    Count other = s->total;
+    for (int j = 0; j < NR_REG; j ++) {
+      Count *c = &s->reg[j];
+      if (c->nr_read == 0 && c->nr_write == 0) continue;
+      _Log("  +0x%-13x %14" PRIu64 " %14" PRIu64 "\n", j, c->nr_read, c->nr_write);
+      other.nr_read -= c->nr_read;
+      other.nr_write -= c->nr_write;
+    }
+    if (other.nr_read != 0 || other.nr_write != 0) {
+      _Log("  >=0x%-11x %14" PRIu64 " %14" PRIu64 "\n", NR_REG, other.nr_read, other.nr_write);
+    }
+    if (s->map->callback == NULL) continue;
+    char line[NR_BUCKET * 32], *p = line;
+    for (int j = 0; j < NR_BUCKET; j ++) {
+      if (s->hist[j] == 0) continue;
+      p += sprintf(p, " <%" PRIu64 "ns:%" PRIu64, (uint64_t)1 << j, s->hist[j]);
+    }
+    _Log("  callback time histogram:%s\n", line);
+  }
+}
+
+void init_dtrace() {
+  const char *file = CONFIG_DTRACE_FILE;
+  if (file[0] == '\0') return;
+  fp = fopen(file, "wb");
+  Assert(fp, "Can not open '%s'", file);
+
+  TraceHeader h = {
+    .magic = TRACE_MAGIC,
+    .version = TRACE_VERSION,
+    .type = TRACE_TYPE_DTRACE,
+    .word_size = sizeof(word_t),
+    .rec_size = REC_SIZE,
+    .triple = DISASM_TRIPLE,
+  };
+  fwrite(&h, sizeof(h), 1, fp);
+  atexit(dtrace_flush);
+  Log("Device trace is written to %s", file);
+}
+#endif
@@ -42,35 +42,43 @@ static void check_bound(IOMap *map, paddr_t addr) {
   }
 }
 
-static void invoke_callback(io_callback_t c, paddr_t offset, int len, bool is_write) {
-  if (c != NULL) { c(offset, len, is_write); }
+// return the host time spent in the callback when DTRACE is enabled
+static uint64_t invoke_callback(io_callback_t c, paddr_t offset, int len, bool is_write) {
+  if (c == NULL) return 0;
+#ifdef CONFIG_DTRACE
+  uint64_t start = dtrace_time();
+  c(offset, len, is_write);
+  return dtrace_time() - start;
+#else
+  c(offset, len, is_write);
+  return 0;
+#endif
 }
 
 void init_map() {
   io_space = malloc(IO_SPACE_MAX);
   assert(io_space);
   p_space = io_space;
+  IFDEF(CONFIG_DTRACE, init_dtrace());
 }
 
 word_t map_read(paddr_t addr, int len, IOMap *map) {
   assert(len >= 1 && len <= 8);
-
-// [TODO] dtrace 每次访问设备的地址时,输出或记录信息
-
   check_bound(map, addr);
   paddr_t offset = addr - map->low;
-  invoke_callback(map->callback, offset, len, false); // prepare data to read
+  uint64_t cb_ns = invoke_callback(map->callback, offset, len, false); // prepare data to read
   word_t ret = host_read(map->space + offset, len);
+  dtrace(map, offset, len, ret, false, cb_ns);
+  IFDEF(CONFIG_PLUGIN, if (unlikely(plugin_events & PLUGIN_EV_DEV)) plugin_dev(map->name, addr, len, ret, false));
   return ret;
 }
 
 void map_write(paddr_t addr, int len, word_t data, IOMap *map) {
   assert(len >= 1 && len <= 8);
-
-// [TODO] dtrace 每次访问设备的地址时,输出或记录信息
-
   check_bound(map, addr);
   paddr_t offset = addr - map->low;
   host_write(map->space + offset, len, data);
-  invoke_callback(map->callback, offset, len, true);
+  uint64_t cb_ns = invoke_callback(map->callback, offset, len, true);
+  dtrace(map, offset, len, data, true, cb_ns);
+  IFDEF(CONFIG_PLUGIN, if (unlikely(plugin_events & PLUGIN_EV_DEV)) plugin_dev(map->name, addr, len, data, true));
 }
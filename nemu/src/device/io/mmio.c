@@ -15,6 +15,7 @@
 
 #include <device/map.h>
 #include <memory/paddr.h>
+#include <prof.h>
 
 #define NR_MAP 16
 
@@ -55,9 +56,16 @@ void add_mmio_map(const char *name, paddr_t addr, void *space, uint32_t len, io_
 
 /* bus interface */
 word_t mmio_read(paddr_t addr, int len) {
-  return map_read(addr, len, fetch_mmio_map(addr));
+  IFDEF(CONFIG_SELF_PROF, int prof = prof_enter(PROF_MMIO));
+  IFDEF(CONFIG_TELEMETRY, telemetry_mmio ++);
+  word_t data = map_read(addr, len, fetch_mmio_map(addr));
+  IFDEF(CONFIG_SELF_PROF, prof_leave(prof));
+  return data;
 }
 
 void mmio_write(paddr_t addr, int len, word_t data) {
+  IFDEF(CONFIG_SELF_PROF, int prof = prof_enter(PROF_MMIO));
+  IFDEF(CONFIG_TELEMETRY, telemetry_mmio ++);
   map_write(addr, len, data, fetch_mmio_map(addr));
+  IFDEF(CONFIG_SELF_PROF, prof_leave(prof));
 }
@@ -20,6 +20,7 @@
 
 #ifndef CONFIG_TARGET_AM
 #include <SDL2/SDL.h>
+#include <stdatomic.h>
 
 // Note that this is not the standard
 #define NEMU_KEYS(f) \
@@ -45,23 +46,40 @@ static void init_keymap() {
   MAP(NEMU_KEYS, SDL_KEYMAP)
 }
 
+/* The key queue is filled by the SDL event thread and drained by the CPU
+ * thread. `key_r' is only written by the producer. When the queue is full
+ * the producer drops the oldest key by advancing `key_f' itself, so the
+ * consumer claims a key with a CAS on `key_f' and retries if it loses.
+ */
 #define KEY_QUEUE_LEN 1024
-static int key_queue[KEY_QUEUE_LEN] = {};
-static int key_f = 0, key_r = 0;
+static _Atomic uint32_t key_queue[KEY_QUEUE_LEN] = {};
+static _Atomic uint32_t key_f = 0, key_r = 0;
 
 static void key_enqueue(uint32_t am_scancode) {
-  key_queue[key_r] = am_scancode;
-  key_r = (key_r + 1) % KEY_QUEUE_LEN;
-  Assert(key_r != key_f, "key queue overflow!");
+  uint32_t r = atomic_load_explicit(&key_r, memory_order_relaxed);
+  uint32_t f = atomic_load_explicit(&key_f, memory_order_acquire);
+  if (r - f == KEY_QUEUE_LEN) {
+    atomic_compare_exchange_strong_explicit(&key_f, &f, f + 1,
+        memory_order_acq_rel, memory_order_acquire);
+  }
+  atomic_store_explicit(&key_queue[r % KEY_QUEUE_LEN], am_scancode, memory_order_relaxed);
+  atomic_store_explicit(&key_r, r + 1, memory_order_release);
 }
 
 static uint32_t key_dequeue() {
-  uint32_t key = NEMU_KEY_NONE;
-  if (key_f != key_r) {
-    key = key_queue[key_f];
-    key_f = (key_f + 1) % KEY_QUEUE_LEN;
+  uint32_t f = atomic_load_explicit(&key_f, memory_order_acquire);
+  while (f != atomic_load_explicit(&key_r, memory_order_acquire)) {
+    uint32_t key = atomic_load_explicit(&key_queue[f % KEY_QUEUE_LEN], memory_order_relaxed);
+    if (atomic_compare_exchange_weak_explicit(&key_f, &f, f + 1,
+          memory_order_acq_rel, memory_order_acquire)) {
+      return key;
+    }
   }
-  return key;
+  return NEMU_KEY_NONE;
+}
+
+void key_queue_clear() {
+  while (key_dequeue() != NEMU_KEY_NONE);
 }
 
 void send_key(uint8_t scancode, bool is_keydown) {
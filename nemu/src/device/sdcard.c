@@ -14,6 +14,8 @@
 ***************************************************************************************/
 
 #include <device/map.h>
+#include <memory/paddr.h>
+#include <cpu/cpu.h>
 #include "mmc.h"
 
 // http://www.files.e-shop.co.il/pdastore/Tech-mmc-samsung/SEC%20MMC%20SPEC%20ver09.pdf
@@ -28,8 +30,12 @@
 #define C_SIZE (NR_BLOCK / MULT - 1)
 
 // This is a simple hardware implementation of linux/drivers/mmc/host/bcm2835.c
-// No DMA and IRQ is supported, so the driver must be modified to start PIO
-// right after sending the actual read/write commands.
+// Data can be moved by PIO through SDDATA, which should be started right after
+// sending the actual read/write commands. There is also a NEMU-specific DMA
+// mode: the driver programs a physical buffer address in SDDMAADDR, the block
+// size in SDHBCT and the block count in SDHBLC, then writes SDDMACTL_START.
+// The whole transfer is performed at once, and SDHSTS_BLOCK_IRPT is set on
+// completion. An interrupt is raised if SDHCFG_BLOCK_IRPT_EN is set.
 
 enum {
   SDCMD, SDARG, SDTOUT, SDCDIV,
@@ -37,9 +43,14 @@ enum {
   SDHSTS, __PAD0, __PAD1, __PAD2,
   SDVDD, SDEDM, SDHCFG, SDHBCT,
   SDDATA, __PAD10, __PAD11, __PAD12,
-  SDHBLC
+  SDHBLC, SDDMAADDR, SDDMACTL
 };
 
+#define SDHSTS_FIFO_ERROR    0x008
+#define SDHSTS_BLOCK_IRPT    0x200
+#define SDHCFG_BLOCK_IRPT_EN 0x100
+#define SDDMACTL_START       0x1
+
 static FILE *fp = NULL;
 static uint32_t *base = NULL;
 static uint32_t blkcnt = 0;
@@ -47,6 +58,7 @@ static long blk_addr = 0;
 static uint32_t addr = 0;
 static bool write_cmd = 0;
 static bool read_ext_csd = false;
+static uint32_t hsts = 0;
 
 static void prepare_rw(int is_write) {
   blk_addr = base[SDARG];
@@ -88,10 +100,42 @@ static void sdcard_handle_cmd(int cmd) {
   }
 }
 
+static void sdcard_dma() {
+  paddr_t dma_addr = base[SDDMAADDR];
+  size_t len = (size_t)(base[SDHBCT] ? base[SDHBCT] : 512) * base[SDHBLC];
+  bool ok = (len == 0) ||
+    (len <= CONFIG_MSIZE && in_pmem(dma_addr) && in_pmem(dma_addr + len - 1));
+  if (ok && len > 0) {
+    uint8_t *buf = guest_to_host(dma_addr);
+    size_t ret = 0;
+    if (fp) { ret = (write_cmd ? fwrite(buf, 1, len, fp) : fread(buf, 1, len, fp)); }
+    if (ret < len) {
+      // reading beyond the end of the image returns zeros
+      if (write_cmd) ok = false;
+      else memset(buf + ret, 0, len - ret);
+    }
+  }
+  hsts |= (ok ? SDHSTS_BLOCK_IRPT : SDHSTS_FIFO_ERROR);
+  if (base[SDHCFG] & SDHCFG_BLOCK_IRPT_EN) dev_raise_intr(INTR_SRC_EXTERNAL);
+}
+
 static void sdcard_io_handler(uint32_t offset, int len, bool is_write) {
   int idx = offset / 4;
   switch (idx) {
     case SDCMD: sdcard_handle_cmd(base[SDCMD] & 0x3f); break;
+    case SDHSTS:
+      // write 1 to clear
+      if (is_write) hsts &= ~base[SDHSTS];
+      base[SDHSTS] = hsts;
+      break;
+    case SDDMACTL:
+      if (is_write && (base[SDDMACTL] & SDDMACTL_START)) sdcard_dma();
+      base[SDDMACTL] = 0;
+      break;
+    case SDHCFG:
+    case SDHBCT:
+    case SDHBLC:
+    case SDDMAADDR:
     case SDARG:
     case SDRSP0:
     case SDRSP1:
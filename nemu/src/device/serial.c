@@ -15,37 +15,156 @@
 
 #include <utils.h>
 #include <device/map.h>
+#include <memory/paddr.h>
+#ifdef CONFIG_SERIAL_INPUT_FIFO
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
 
 /* http://en.wikibooks.org/wiki/Serial_Programming/8250_UART_Programming */
 // NOTE: this is compatible to 16550
 
 #define CH_OFFSET 0
+#define LSR_OFFSET 5
+
+/* Paravirtual console beyond the 16550 registers: the guest writes the
+ * physical address of a string to PV_ADDR_OFFSET, then its length to
+ * PV_LEN_OFFSET, and the whole span is output at once. Reading
+ * PV_LEN_OFFSET returns PV_MAGIC so that the guest can detect it.
+ */
+#define PV_ADDR_OFFSET 8
+#define PV_LEN_OFFSET 12
+#define PV_MAGIC 0x554d454e // "NEMU"
+#define SERIAL_SPACE 16
+
+#define LSR_RX_READY 0x01
+#define LSR_TX_READY 0x20
+#define LSR_TX_EMPTY 0x40
 
 static uint8_t *serial_base = NULL;
 
+#ifndef CONFIG_TARGET_AM
+/* Output is collected here and written to stderr in bulk, instead of
+ * issuing one write() per guest byte.
+ */
+#define OBUF_SIZE 4096
+static char obuf[OBUF_SIZE];
+static int olen = 0;
+#endif
+
+void serial_flush() {
+#ifndef CONFIG_TARGET_AM
+  if (olen > 0) {
+    fwrite(obuf, 1, olen, stderr);
+    olen = 0;
+  }
+#endif
+}
 
 static void serial_putc(char ch) {
-  MUXDEF(CONFIG_TARGET_AM, putch(ch), putc(ch, stderr));
+#ifdef CONFIG_TARGET_AM
+  putch(ch);
+#else
+  obuf[olen ++] = ch;
+  if (ch == '\n' || olen == OBUF_SIZE) serial_flush();
+#endif
 }
 
+static void serial_pv_write() {
+  uint32_t addr = *(uint32_t *)(serial_base + PV_ADDR_OFFSET);
+  uint32_t len = *(uint32_t *)(serial_base + PV_LEN_OFFSET);
+  if (len == 0) return;
+  // the guest may pass any address, e.g. a virtual one under paging
+  if (len > CONFIG_MSIZE || !in_pmem(addr) || !in_pmem(addr + len - 1)) {
+    Log("serial: console buffer [" FMT_PADDR ", +%u) is out of pmem, ignored", addr, len);
+    return;
+  }
+  char *p = (char *)guest_to_host(addr);
+  for (uint32_t i = 0; i < len; i ++) serial_putc(p[i]);
+}
+
+#ifdef CONFIG_SERIAL_INPUT_FIFO
+#define IBUF_SIZE 256
+static uint8_t ibuf[IBUF_SIZE];
+static int ihead = 0, itail = 0;
+static int input_fd = -1;
+
+static bool serial_rx_ready() {
+  if (ihead != itail) return true;
+  if (input_fd < 0) return false;
+  struct pollfd pfd = { .fd = input_fd, .events = POLLIN };
+  if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLIN)) return false;
+  ssize_t n = read(input_fd, ibuf, IBUF_SIZE);
+  if (n <= 0) return false;
+  ihead = 0;
+  itail = n;
+  return true;
+}
+
+static uint8_t serial_getc() {
+  return serial_rx_ready() ? ibuf[ihead ++] : 0xff;
+}
+
+static void init_fifo() {
+  const char *path = CONFIG_SERIAL_INPUT_PATH;
+  if (path[0] == '\0') {
+    // use stdin; it is polled rather than made non-blocking,
+    // since it is shared with the sdb command line
+    input_fd = STDIN_FILENO;
+    return;
+  }
+  if (mkfifo(path, 0666) != 0 && errno != EEXIST) {
+    Log("Can not create serial input FIFO '%s': %s", path, strerror(errno));
+    return;
+  }
+  // open with O_RDWR so that the FIFO never sees EOF when writers come and go
+  input_fd = open(path, O_RDWR | O_NONBLOCK);
+  if (input_fd < 0) Log("Can not open serial input FIFO '%s': %s", path, strerror(errno));
+  else Log("Serial input is read from '%s'", path);
+}
+#endif
+
 static void serial_io_handler(uint32_t offset, int len, bool is_write) {
-  assert(len == 1);
+  assert(len == (offset < PV_ADDR_OFFSET ? 1 : 4));
   switch (offset) {
     /* We bind the serial port with the host stderr in NEMU. */
     case CH_OFFSET:
       if (is_write) serial_putc(serial_base[0]);
-      else panic("do not support read");
+      else {
+#ifdef CONFIG_SERIAL_INPUT_FIFO
+        // the guest is probably waiting for input, so show its prompt
+        serial_flush();
+        serial_base[0] = serial_getc();
+#else
+        panic("do not support read");
+#endif
+      }
+      break;
+    case LSR_OFFSET:
+      if (is_write) break;
+      serial_base[LSR_OFFSET] = LSR_TX_READY | LSR_TX_EMPTY |
+        MUXDEF(CONFIG_SERIAL_INPUT_FIFO, (serial_rx_ready() ? LSR_RX_READY : 0), 0);
+      break;
+    case PV_ADDR_OFFSET: break;
+    case PV_LEN_OFFSET:
+      if (is_write) serial_pv_write();
+      else *(uint32_t *)(serial_base + PV_LEN_OFFSET) = PV_MAGIC;
       break;
     default: panic("do not support offset = %d", offset);
   }
 }
 
 void init_serial() {
-  serial_base = new_space(8);
+  serial_base = new_space(SERIAL_SPACE);
 #ifdef CONFIG_HAS_PORT_IO
-  add_pio_map ("serial", CONFIG_SERIAL_PORT, serial_base, 8, serial_io_handler);
+  add_pio_map ("serial", CONFIG_SERIAL_PORT, serial_base, SERIAL_SPACE, serial_io_handler);
 #else
-  add_mmio_map("serial", CONFIG_SERIAL_MMIO, serial_base, 8, serial_io_handler);
+  add_mmio_map("serial", CONFIG_SERIAL_MMIO, serial_base, SERIAL_SPACE, serial_io_handler);
 #endif
 
+  IFNDEF(CONFIG_TARGET_AM, atexit(serial_flush));
+  IFDEF(CONFIG_SERIAL_INPUT_FIFO, init_fifo());
 }
@@ -37,10 +37,19 @@ static uint32_t *vgactl_port_base = NULL;
 #ifdef CONFIG_VGA_SHOW_SCREEN
 #ifndef CONFIG_TARGET_AM
 #include <SDL2/SDL.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 static SDL_Renderer *renderer = NULL;
 static SDL_Texture *texture = NULL;
 
+/* The sync register and vmem are only touched by the CPU thread, which
+ * copies a synced frame into `frame'. The SDL thread presents it later.
+ */
+static uint32_t frame[SCREEN_W * SCREEN_H];
+static pthread_mutex_t frame_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_bool frame_ready = false;
+
 static void init_screen() {
   SDL_Window *window = NULL;
   char title[128];
@@ -57,7 +66,18 @@ static void init_screen() {
 }
 
 static inline void update_screen() {
-  SDL_UpdateTexture(texture, NULL, vmem, SCREEN_W * sizeof(uint32_t));
+  pthread_mutex_lock(&frame_lock);
+  memcpy(frame, vmem, sizeof(frame));
+  pthread_mutex_unlock(&frame_lock);
+  atomic_store_explicit(&frame_ready, true, memory_order_release);
+}
+
+// called by the SDL thread
+void vga_present_screen() {
+  if (!atomic_exchange_explicit(&frame_ready, false, memory_order_acquire)) return;
+  pthread_mutex_lock(&frame_lock);
+  SDL_UpdateTexture(texture, NULL, frame, SCREEN_W * sizeof(uint32_t));
+  pthread_mutex_unlock(&frame_lock);
   SDL_RenderClear(renderer);
   SDL_RenderCopy(renderer, texture, NULL, NULL);
   SDL_RenderPresent(renderer);
@@ -71,6 +91,10 @@ static inline void update_screen() {
 #endif
 #endif
 
+void vga_init_screen() {
+  IFDEF(CONFIG_VGA_SHOW_SCREEN, init_screen());
+}
+
 void vga_update_screen() {
   // TODO: call `update_screen()` when the sync register is non-zero,
   // then zero out the sync register
@@ -91,6 +115,7 @@ void init_vga() {
 
   vmem = new_space(screen_size());
   add_mmio_map("vmem", CONFIG_FB_ADDR, vmem, screen_size(), NULL);
-  IFDEF(CONFIG_VGA_SHOW_SCREEN, init_screen());
+  // on the native target the screen is created by the SDL thread
+  IFDEF(CONFIG_TARGET_AM, vga_init_screen());
   IFDEF(CONFIG_VGA_SHOW_SCREEN, memset(vmem, 0, screen_size()));
 }
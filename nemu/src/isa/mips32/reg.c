@@ -29,3 +29,7 @@ void isa_reg_display() {
 word_t isa_reg_str2val(const char *s, bool *success) {
   return 0;
 }
+
+int isa_reg_str2idx(const char *s) {
+  return -1;
+}
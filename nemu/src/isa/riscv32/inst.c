@@ -36,6 +36,14 @@ enum {
 #define immJ() do { *imm = ((SEXT(BITS(i, 31, 31), 1) << 20) | (BITS(i, 19, 12) << 12) | (BITS(i, 20, 20) << 11) | (BITS(i, 30, 21) << 1)) ; } while(0)
 #define immB() do { *imm = ((SEXT(BITS(i, 31, 31), 1) << 12) | (BITS(i, 7, 7) << 11) | (BITS(i, 30, 25) << 5) | (BITS(i, 11, 8) << 1)) ; } while(0)
 
+// classify the INSTPATs for the instruction mix
+#define INSTPAT_CLASS(name, type) ( \
+  concat(TYPE_, type) == TYPE_S ? INSTMIX_STORE : \
+  concat(TYPE_, type) == TYPE_B ? INSTMIX_BRANCH : \
+  concat(TYPE_, type) == TYPE_J ? INSTMIX_JUMP : \
+  concat(TYPE_, type) == TYPE_I && #name[0] == 'l' ? INSTMIX_LOAD : \
+  concat(TYPE_, type) == TYPE_I && #name[0] == 'j' ? INSTMIX_JUMP : INSTMIX_OTHER)
+
 static void decode_operand(Decode *s, int *rd, word_t *src1, word_t *src2, word_t *imm, int type) {
   uint32_t i = s->isa.inst.val;
   // 在riscv中，source/target寄存器的位置是固定的，所以可直接提取。和手册匹配。
@@ -54,6 +62,15 @@ static void decode_operand(Decode *s, int *rd, word_t *src1, word_t *src2, word_
   }
 }
 
+// feed the outcome of branches and jumps to the branch predictors,
+// jalr passes rs1 so that returns can be recognized
+#define BPSIM(s, name, type) do { \
+  if (concat(TYPE_, type) == TYPE_B) bpsim_cond((s)->pc, (s)->dnpc != (s)->snpc); \
+  else if (concat(TYPE_, type) == TYPE_J) bpsim_jump((s)->pc, (s)->dnpc, rd, -1); \
+  else if (concat(TYPE_, type) == TYPE_I && #name[0] == 'j') \
+    bpsim_jump((s)->pc, (s)->dnpc, rd, BITS((s)->isa.inst.val, 19, 15)); \
+} while (0)
+
 static int decode_exec(Decode *s) {
   int rd = 0;
   word_t src1 = 0, src2 = 0, imm = 0;
@@ -63,6 +80,7 @@ static int decode_exec(Decode *s) {
 #define INSTPAT_MATCH(s, name, type, ... /* execute body */ ) { \
   decode_operand(s, &rd, &src1, &src2, &imm, concat(TYPE_, type)); \
   __VA_ARGS__ ; \
+  IFDEF(CONFIG_BPSIM, BPSIM(s, name, type)); \
 }
 
   INSTPAT_START();
@@ -90,7 +108,7 @@ static int decode_exec(Decode *s) {
   INSTPAT("0000000 ????? ????? 001 ????? 00100 11", slli   , I, R(rd) = src1 << (imm & 0x1f)); // 逻辑左移
   INSTPAT("??????? ????? ????? 000 ????? 00100 11", addi   , I, R(rd) = src1 + imm); // 伪指令li的一种实现
   INSTPAT("??????? ????? ????? 000 ????? 11001 11", jalr   , I, R(rd) = s->snpc; s->dnpc = src1 + imm;
-                                                                IFDEF(CONFIG_FTRACE, 
+                                                                IFDEF(CONFIG_FUNC_HOOK, 
                                                                   if(s->isa.inst.val == 0x78067){
                                                                     // [TODO]不知道是什么,为什么跳过
                                                                     // 000000000000 01111 000 00000 1100111
@@ -106,25 +124,25 @@ static int decode_exec(Decode *s) {
                                                                     // 理解为调用返回指令
                                                                     // [riscv标准]即 ret -> jalr x0, 0(x1)
                                                                     // 000000000000 00001 000 00000 1100111
-                                                                    ftrace_ret_print(s->pc, s->dnpc);
+                                                                    trace_func_ret(s->pc, s->dnpc);
                                                                   }
                                                                   else if(rd == 1) {
                                                                     // (rd == 1 || rd == 5) && (src1 != 1 && src1 != 5)
                                                                     // [riscv标准] 函数调用指令
-                                                                    ftrace_call_print(s->pc, s->dnpc, false);
+                                                                    trace_func_call(s->pc, s->dnpc, false);
                                                                   }
                                                                   else if(rd == 0 && imm == 0) {
                                                                     // 据说是尾调用的特征
                                                                     // [riscv标准]即 jr -> jalr x0, 0(rs1)
                                                                     // 区别于ret,这里rs1可以为其他的寄存器,是一种间接跳转。
-                                                                    ftrace_call_print(s->pc, s->dnpc, true);
+                                                                    trace_func_call(s->pc, s->dnpc, true);
                                                                   }
                                                                 ));
 
   INSTPAT("??????? ????? ????? ??? ????? 11011 11", jal    , J, R(rd) = s->snpc; s->dnpc = s->pc + imm; 
-                                                                IFDEF(CONFIG_FTRACE, 
+                                                                IFDEF(CONFIG_FUNC_HOOK, 
                                                                   if(rd == 1) { // [riscv标准]目标寄存器为x1或x5时, 判定在做函数调用
-                                                                    ftrace_call_print(s->pc, s->dnpc, false);
+                                                                    trace_func_call(s->pc, s->dnpc, false);
                                                                   }
                                                                 ));
 
@@ -42,18 +42,21 @@ void isa_reg_display() {
   }
 }
 
-word_t isa_reg_str2val(const char *s, bool *success) {
-  *success = true;
+int isa_reg_str2idx(const char *s) {
   if (strcmp(s, regs[0]) == 0){
-    return cpu.gpr[0];
+    return 0;
   }
 
   for (int i = 1; i < ARRLEN(regs); i++) {
     if (strcmp(regs[i], s+1) == 0) { // ignore the first character '$' 
-      *success = true;
-      return cpu.gpr[i];
+      return i;
     }
   }
-  *success = false;
   return -1;
 }
+
+word_t isa_reg_str2val(const char *s, bool *success) {
+  int i = isa_reg_str2idx(s);
+  *success = (i != -1);
+  return (i != -1 ? cpu.gpr[i] : -1);
+}
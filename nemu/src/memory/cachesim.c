@@ -0,0 +1,177 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <memory/cachesim.h>
+#include <memory/paddr.h>
+
+#ifdef CONFIG_CACHESIM
+/* A set-associative cache indexed by line address. Writes allocate like
+ * reads, and write-backs are not modeled. A miss goes to the next level.
+ * Only accesses to pmem are simulated, MMIO is uncached.
+ */
+typedef struct Cache {
+  const char *name;
+  int nr_set, assoc;
+  uint64_t *tag;    // line address + 1 of each way, 0 means invalid
+  uint64_t *stamp;  // time of the last access (LRU) or of the fill (FIFO)
+  uint64_t access, miss;
+  struct Cache *next;
+} Cache;
+
+enum { L1I, L1D, L2, NR_LEVEL };
+
+static Cache caches[NR_LEVEL];
+static uint64_t now = 0;
+
+CacheReq cache_batch[CACHE_BATCH];
+int cache_nr_req = 0;
+
+// per-function counters, keyed by the start of the symbol
+typedef struct {
+  vaddr_t addr;
+  const char *name;
+  uint64_t access[NR_LEVEL], miss[NR_LEVEL];
+} FuncStat;
+
+#define NR_FUNC_SLOT 4096
+static FuncStat funcs[NR_FUNC_SLOT];
+static bool func_used[NR_FUNC_SLOT];
+static FuncStat func_other = { .name = "(others)" };
+
+static FuncStat *func_of(vaddr_t pc) {
+  vaddr_t start = pc;
+  const char *name = symtab_lookup(pc, &start);
+  if (name == NULL) return &func_other;
+  for (uint32_t i = (start >> 2) % NR_FUNC_SLOT, n = 0; n < NR_FUNC_SLOT; i = (i + 1) % NR_FUNC_SLOT, n ++) {
+    if (!func_used[i]) {
+      func_used[i] = true;
+      funcs[i] = (FuncStat) { .addr = start, .name = name };
+      return &funcs[i];
+    }
+    if (funcs[i].addr == start) return &funcs[i];
+  }
+  return &func_other;
+}
+
+static void init_cache(Cache *c, const char *name, int size_kb, int assoc, Cache *next) {
+  c->name = name;
+  c->assoc = assoc;
+  c->nr_set = size_kb * 1024 / CONFIG_CACHE_LINE_SIZE / assoc;
+  c->next = next;
+  Assert(assoc > 0 && c->nr_set > 0 && (c->nr_set & (c->nr_set - 1)) == 0,
+      "%s: %d KB, %d-way with %d-byte lines does not give a power-of-2 number of sets",
+      name, size_kb, assoc, CONFIG_CACHE_LINE_SIZE);
+  c->tag = calloc(c->nr_set * assoc, sizeof(c->tag[0]));
+  c->stamp = calloc(c->nr_set * assoc, sizeof(c->stamp[0]));
+  Assert(c->tag && c->stamp, "out of memory");
+}
+
+static void cache_access(Cache *c, uint64_t line, FuncStat *f) {
+  for (; c != NULL; c = c->next) {
+    int level = c - caches;
+    c->access ++;
+    f->access[level] ++;
+    uint64_t *tag = c->tag + (line & (c->nr_set - 1)) * c->assoc;
+    uint64_t *stamp = c->stamp + (tag - c->tag);
+    int victim = 0;
+    for (int i = 0; i < c->assoc; i ++) {
+      if (tag[i] == line + 1) {
+        IFDEF(CONFIG_CACHE_REPLACE_LRU, stamp[i] = now);
+        return;
+      }
+      if (tag[i] == 0 || (tag[victim] != 0 && stamp[i] < stamp[victim])) victim = i;
+    }
+    IFDEF(CONFIG_CACHE_REPLACE_RANDOM, if (tag[victim] != 0) victim = rand() % c->assoc);
+    tag[victim] = line + 1;
+    stamp[victim] = now;
+    c->miss ++;
+    f->miss[level] ++;
+  }
+}
+
+void cachesim_flush() {
+  static vaddr_t last_pc = 0;
+  static FuncStat *last_f = &func_other;
+  const int shift = __builtin_ctz(CONFIG_CACHE_LINE_SIZE);
+  for (int i = 0; i < cache_nr_req; i ++) {
+    CacheReq *r = &cache_batch[i];
+    if (!in_pmem(r->addr)) continue; // device registers are not cached
+    if (r->pc != last_pc) { last_pc = r->pc; last_f = func_of(r->pc); }
+    Cache *c = &caches[r->type == CACHE_IFETCH ? L1I : L1D];
+    uint64_t first = r->addr >> shift, last = ((uint64_t)r->addr + r->len - 1) >> shift;
+    for (uint64_t line = first; line <= last; line ++) {
+      now ++;
+      cache_access(c, line, last_f);
+    }
+  }
+  cache_nr_req = 0;
+}
+
+static double miss_rate(uint64_t miss, uint64_t access) {
+  return access ? 100.0 * miss / access : 0;
+}
+
+static int cmp_func(const void *a, const void *b) {
+  const FuncStat *x = *(FuncStat * const *)a, *y = *(FuncStat * const *)b;
+  uint64_t mx = x->miss[L1I] + x->miss[L1D], my = y->miss[L1I] + y->miss[L1D];
+  return (mx < my) - (mx > my);
+}
+
+#define NR_FUNC_SHOW 20
+
+void cachesim_report() {
+  cachesim_flush();
+  _Log("cache simulation (%d-byte lines, %s replacement):\n", CONFIG_CACHE_LINE_SIZE,
+      MUXDEF(CONFIG_CACHE_REPLACE_LRU, "LRU", MUXDEF(CONFIG_CACHE_REPLACE_FIFO, "FIFO", "random")));
+  _Log("%-6s %10s %6s %16s %16s %8s\n", "level", "sets", "ways", "accesses", "misses", "miss%");
+  for (int i = 0; i < NR_LEVEL; i ++) {
+    Cache *c = &caches[i];
+    if (c->nr_set == 0) continue;
+    _Log("%-6s %10d %6d %16" PRIu64 " %16" PRIu64 " %8.2f\n", c->name, c->nr_set, c->assoc,
+        c->access, c->miss, miss_rate(c->miss, c->access));
+  }
+
+  static FuncStat *sorted[NR_FUNC_SLOT + 1];
+  int n = 0;
+  for (int i = 0; i < NR_FUNC_SLOT; i ++) {
+    if (func_used[i]) sorted[n ++] = &funcs[i];
+  }
+  if (func_other.access[L1I] + func_other.access[L1D] > 0) sorted[n ++] = &func_other;
+  if (n == 0) return;
+  qsort(sorted, n, sizeof(sorted[0]), cmp_func);
+  _Log("functions with the most L1 misses:\n");
+  _Log("%-24s %16s %8s %16s %8s %16s %8s\n", "function", "L1I misses", "miss%",
+      "L1D misses", "miss%", "L2 misses", "miss%");
+  for (int i = 0; i < n && i < NR_FUNC_SHOW; i ++) {
+    FuncStat *f = sorted[i];
+    _Log("%-24s %16" PRIu64 " %8.2f %16" PRIu64 " %8.2f %16" PRIu64 " %8.2f\n", f->name,
+        f->miss[L1I], miss_rate(f->miss[L1I], f->access[L1I]),
+        f->miss[L1D], miss_rate(f->miss[L1D], f->access[L1D]),
+        f->miss[L2], miss_rate(f->miss[L2], f->access[L2]));
+  }
+}
+
+void init_cachesim() {
+  Cache *l2 = NULL;
+  if (CONFIG_CACHE_L2_SIZE > 0) {
+    init_cache(&caches[L2], "L2", CONFIG_CACHE_L2_SIZE, CONFIG_CACHE_L2_ASSOC, NULL);
+    l2 = &caches[L2];
+  }
+  init_cache(&caches[L1I], "L1I", CONFIG_CACHE_L1I_SIZE, CONFIG_CACHE_L1I_ASSOC, l2);
+  init_cache(&caches[L1D], "L1D", CONFIG_CACHE_L1D_SIZE, CONFIG_CACHE_L1D_ASSOC, l2);
+  Assert((CONFIG_CACHE_LINE_SIZE & (CONFIG_CACHE_LINE_SIZE - 1)) == 0, "cache line size must be a power of 2");
+}
+#endif
@@ -0,0 +1,108 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <isa.h>
+#include <memory/paddr.h>
+
+#ifdef CONFIG_MTRACE
+#include <trace-def.h>
+
+#define REC_SIZE MTRACE_REC_SIZE(sizeof(word_t))
+#define BUF_SIZE (1024 * 1024 / REC_SIZE * REC_SIZE)
+#define NR_RANGE 16
+
+extern uint64_t g_nr_guest_inst;
+
+paddr_t mtrace_lo = 0, mtrace_hi = (paddr_t)-1;
+static struct { paddr_t lo, hi; } range[NR_RANGE];
+static int nr_range = 0;
+
+static uint8_t buf[BUF_SIZE];
+static size_t len = 0;
+static FILE *fp = NULL;
+
+void mtrace_flush() {
+  if (fp != NULL && len > 0) {
+    fwrite(buf, 1, len, fp);
+    IFDEF(CONFIG_TELEMETRY, trace_bytes += len);
+    fflush(fp);
+    len = 0;
+  }
+}
+
+void mtrace_record(paddr_t addr, int size, word_t data, bool is_write) {
+  if (g_nr_guest_inst < CONFIG_MTRACE_START) return;
+  if (CONFIG_MTRACE_END != 0 && g_nr_guest_inst >= CONFIG_MTRACE_END) {
+    // nothing will be recorded any more
+    mtrace_lo = 1; mtrace_hi = 0;
+    return;
+  }
+  if (nr_range > 1) {
+    int i;
+    for (i = 0; i < nr_range; i ++) {
+      if (addr - range[i].lo <= range[i].hi - range[i].lo) break;
+    }
+    if (i == nr_range) return;
+  }
+
+  if (unlikely(len == BUF_SIZE)) mtrace_flush();
+  uint8_t *p = buf + len;
+  uint64_t addr64 = addr;
+  uint8_t info = size | (is_write ? MTRACE_WRITE : 0);
+  memcpy(p, &cpu.pc, sizeof(word_t)); p += sizeof(word_t);
+  memcpy(p, &addr64, sizeof(addr64)); p += sizeof(addr64);
+  memcpy(p, &data, sizeof(word_t)); p += sizeof(word_t);
+  *p = info;
+  len += REC_SIZE;
+}
+
+static void parse_ranges(const char *s) {
+  while (*s != '\0') {
+    char *end;
+    paddr_t lo = strtoull(s, &end, 0);
+    Assert(*end == '-', "bad MTRACE range at '%s'", s);
+    paddr_t hi = strtoull(end + 1, &end, 0);
+    Assert((*end == ',' || *end == '\0') && lo <= hi, "bad MTRACE range at '%s'", s);
+    Assert(nr_range < NR_RANGE, "too many MTRACE ranges, at most %d", NR_RANGE);
+    range[nr_range].lo = lo;
+    range[nr_range].hi = hi;
+    if (nr_range == 0 || lo < mtrace_lo) mtrace_lo = lo;
+    if (nr_range == 0 || hi > mtrace_hi) mtrace_hi = hi;
+    nr_range ++;
+    s = (*end == ',' ? end + 1 : end);
+  }
+}
+
+void init_mtrace() {
+  parse_ranges(CONFIG_MTRACE_RANGES);
+
+  const char *file = CONFIG_MTRACE_FILE;
+  fp = fopen(file, "wb");
+  Assert(fp, "Can not open '%s'", file);
+
+  TraceHeader h = {
+    .magic = TRACE_MAGIC,
+    .version = TRACE_VERSION,
+    .type = TRACE_TYPE_MTRACE,
+    .word_size = sizeof(word_t),
+    .rec_size = REC_SIZE,
+    .triple = DISASM_TRIPLE,
+  };
+  fwrite(&h, sizeof(h), 1, fp);
+  atexit(mtrace_flush);
+  Log("Memory trace is written to %s", file);
+}
+#endif
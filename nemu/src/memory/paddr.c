@@ -16,6 +16,8 @@
 #include <memory/host.h>
 #include <memory/paddr.h>
 #include <device/mmio.h>
+#include <memory/cachesim.h>
+#include <prof.h>
 #include <isa.h>
 
 #if   defined(CONFIG_PMEM_MALLOC)
@@ -47,26 +49,44 @@ void init_mem() {
   assert(pmem);
 #endif
   IFDEF(CONFIG_MEM_RANDOM, memset(pmem, rand(), CONFIG_MSIZE));
+  IFDEF(CONFIG_CACHESIM, init_cachesim());
   Log("physical memory area [" FMT_PADDR ", " FMT_PADDR "]", PMEM_LEFT, PMEM_RIGHT);
 }
 
-word_t paddr_read(paddr_t addr, int len) {
-#ifdef CONFIG_MTRACE
-  // TODO MTRACE
-  printf("\33[1;31 [TODO] MTRACE 记录/输出内存read信息 \33[0m\n");
-#endif
+static inline word_t do_paddr_read(paddr_t addr, int len) {
   if (likely(in_pmem(addr))) return pmem_read(addr, len);
   IFDEF(CONFIG_DEVICE, return mmio_read(addr, len));
   out_of_bound(addr);
   return 0;
 }
 
-void paddr_write(paddr_t addr, int len, word_t data) {
-#ifdef CONFIG_MTRACE
-  // TODO MTRACE
-  printf("\33[1;31 [TODO] MTRACE 记录/输出内存write信息 \33[0m\n");
-#endif
-  if (likely(in_pmem(addr))) { pmem_write(addr, len, data); return; }
+// instruction fetches are not recorded by MTRACE
+word_t paddr_ifetch(paddr_t addr, int len) {
+  return do_paddr_read(addr, len);
+}
+
+word_t paddr_read(paddr_t addr, int len) {
+  IFDEF(CONFIG_SELF_PROF, int prof = prof_enter(PROF_MEM));
+  word_t data = do_paddr_read(addr, len);
+  IFDEF(CONFIG_MTRACE, mtrace(addr, len, data, false));
+  IFDEF(CONFIG_SELF_PROF, prof_leave(prof));
+  return data;
+}
+
+static inline void do_paddr_write(paddr_t addr, int len, word_t data) {
+  if (likely(in_pmem(addr))) {
+    IFDEF(CONFIG_WATCHPOINT, if (unlikely(dwatch_test(addr))) dwatch_write(addr, len, data));
+    pmem_write(addr, len, data);
+    return;
+  }
   IFDEF(CONFIG_DEVICE, mmio_write(addr, len, data); return);
   out_of_bound(addr);
 }
+
+void paddr_write(paddr_t addr, int len, word_t data) {
+  IFDEF(CONFIG_SELF_PROF, int prof = prof_enter(PROF_MEM));
+  IFDEF(CONFIG_MTRACE, mtrace(addr, len, data, true));
+  IFDEF(CONFIG_TRACE_TRIGGER, if (unlikely(trigger_wr_armed)) trigger_write(addr, len));
+  do_paddr_write(addr, len, data);
+  IFDEF(CONFIG_SELF_PROF, prof_leave(prof));
+}
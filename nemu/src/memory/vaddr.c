@@ -15,15 +15,22 @@
 
 #include <isa.h>
 #include <memory/paddr.h>
+#include <memory/cachesim.h>
 
 word_t vaddr_ifetch(vaddr_t addr, int len) {
-  return paddr_read(addr, len);
+  IFDEF(CONFIG_CACHESIM, cachesim_access(addr, len, CACHE_IFETCH));
+  return paddr_ifetch(addr, len);
 }
 
 word_t vaddr_read(vaddr_t addr, int len) {
-  return paddr_read(addr, len);
+  IFDEF(CONFIG_CACHESIM, cachesim_access(addr, len, CACHE_READ));
+  word_t data = paddr_read(addr, len);
+  IFDEF(CONFIG_PLUGIN, if (unlikely(plugin_events & PLUGIN_EV_MEM)) plugin_mem(addr, len, data, false));
+  return data;
 }
 
 void vaddr_write(vaddr_t addr, int len, word_t data) {
+  IFDEF(CONFIG_CACHESIM, cachesim_access(addr, len, CACHE_WRITE));
+  IFDEF(CONFIG_PLUGIN, if (unlikely(plugin_events & PLUGIN_EV_MEM)) plugin_mem(addr, len, data, true));
   paddr_write(addr, len, data);
 }
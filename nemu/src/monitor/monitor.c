@@ -17,13 +17,13 @@
 #include <memory/paddr.h>
 
 void init_rand();
-void parse_elf(const char *elf_file);
 void init_log(const char *log_file);
 void init_mem();
 void init_difftest(char *ref_so_file, long img_size, int port);
 void init_device();
 void init_sdb();
 void init_disasm(const char *triple);
+void init_bpsim();
 
 static void welcome() {
   Log("Trace: %s", MUXDEF(CONFIG_TRACE, ANSI_FMT("ON", ANSI_FG_GREEN), ANSI_FMT("OFF", ANSI_FG_RED)));
@@ -75,17 +75,25 @@ static int parse_args(int argc, char *argv[]) {
     {"log"      , required_argument, NULL, 'l'},
     {"diff"     , required_argument, NULL, 'd'},
     {"port"     , required_argument, NULL, 'p'},
+    {"plugin"   , required_argument, NULL, 'P'},
+    {"trace"    , required_argument, NULL, 't'},
     {"help"     , no_argument      , NULL, 'h'},
     {0          , 0                , NULL,  0 },
   };
   int o;
-  while ( (o = getopt_long(argc, argv, "-be:hl:d:p:", table, NULL)) != -1) {
+  while ( (o = getopt_long(argc, argv, "-be:hl:d:p:P:t:", table, NULL)) != -1) {
     switch (o) {
       case 'b': sdb_set_batch_mode(); break;
       case 'e': elf_file = optarg; break;
       case 'p': sscanf(optarg, "%d", &difftest_port); break;
       case 'l': log_file = optarg; break;
       case 'd': diff_so_file = optarg; break;
+#ifdef CONFIG_PLUGIN
+      case 'P': plugin_add(optarg); break;
+#endif
+#ifdef CONFIG_TRACE_TRIGGER
+      case 't': trigger_add_spec(optarg); break;
+#endif
       case 1: img_file = optarg; return 0;
       default:
         printf("Usage: %s [OPTION...] IMAGE [args]\n\n", argv[0]);
@@ -94,6 +102,8 @@ static int parse_args(int argc, char *argv[]) {
         printf("\t-l,--log=FILE           output log to FILE\n");
         printf("\t-d,--diff=REF_SO        run DiffTest with reference REF_SO\n");
         printf("\t-p,--port=PORT          run DiffTest with port PORT\n");
+        IFDEF(CONFIG_PLUGIN, printf("\t-P,--plugin=SO[,ARGS]   load the instrumentation plugin SO\n"));
+        IFDEF(CONFIG_TRACE_TRIGGER, printf("\t-t,--trace=on|off[:COND] turn tracing on/off at pc=, sym=, inst= or write=\n"));
         printf("\n");
         exit(0);
     }
@@ -110,13 +120,16 @@ void init_monitor(int argc, char *argv[]) {
   /* Set random seed. */
   init_rand();
 
-  #ifdef CONFIG_FTRACE
-  parse_elf(elf_file);
-  #endif
-
   /* Open the log file. */
   init_log(log_file);
 
+  #ifdef CONFIG_SYMTAB
+  init_symtab(elf_file);
+  #endif
+
+  /* Arm the trace triggers, which may refer to symbols. */
+  IFDEF(CONFIG_TRACE_TRIGGER, init_trigger());
+
   /* Initialize memory. */
   init_mem();
 
@@ -136,15 +149,13 @@ void init_monitor(int argc, char *argv[]) {
   init_sdb();
 
 #ifndef CONFIG_ISA_loongarch32r
-  IFDEF(CONFIG_ITRACE, init_disasm(
-    MUXDEF(CONFIG_ISA_x86,     "i686",
-    MUXDEF(CONFIG_ISA_mips32,  "mipsel",
-    MUXDEF(CONFIG_ISA_riscv,
-      MUXDEF(CONFIG_RV64,      "riscv64",
-                               "riscv32"),
-                               "bad"))) "-pc-linux-gnu"
-  ));
+  IFDEF(CONFIG_ITRACE, init_disasm(DISASM_TRIPLE));
 #endif
+  IFDEF(CONFIG_ITRACE_BINARY, init_itrace());
+  IFDEF(CONFIG_MTRACE, init_mtrace());
+  IFDEF(CONFIG_BPSIM, init_bpsim());
+  IFDEF(CONFIG_TELEMETRY, init_telemetry());
+  IFDEF(CONFIG_PLUGIN, init_plugins());
 
   /* Display welcome message. */
   welcome();
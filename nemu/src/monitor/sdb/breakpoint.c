@@ -0,0 +1,108 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <isa.h>
+#include "sdb.h"
+
+#ifdef CONFIG_BREAKPOINT
+#define NR_BP 32
+#define BP_HASH_SIZE 128  // power of 2, at least twice NR_BP
+
+/* The pcs of the breakpoints are kept in an open-addressing hash set, so
+ * checking the next pc costs one probe in most cases. The execute loop
+ * only calls breakpoint_hit() when `nr_breakpoint' is not zero.
+ */
+typedef struct {
+  int NO;
+  vaddr_t pc;
+  uint64_t hits;
+} BP;
+
+int nr_breakpoint = 0;
+static BP bps[NR_BP];
+static int table[BP_HASH_SIZE];  // index into bps, or -1
+static int next_NO = 0;
+
+static inline uint32_t bp_hash(vaddr_t pc) {
+  return ((uint32_t)(pc >> 1) * 0x9e3779b1u) >> 25;
+}
+
+static void rebuild_table() {
+  for (int i = 0; i < BP_HASH_SIZE; i ++) table[i] = -1;
+  for (int i = 0; i < nr_breakpoint; i ++) {
+    uint32_t h = bp_hash(bps[i].pc);
+    while (table[h] != -1) h = (h + 1) & (BP_HASH_SIZE - 1);
+    table[h] = i;
+  }
+}
+
+static int bp_find(vaddr_t pc) {
+  for (uint32_t h = bp_hash(pc); table[h] != -1; h = (h + 1) & (BP_HASH_SIZE - 1)) {
+    if (bps[table[h]].pc == pc) return table[h];
+  }
+  return -1;
+}
+
+bool add_breakpoint(vaddr_t pc) {
+  if (bp_find(pc) != -1) {
+    printf("Breakpoint at " FMT_WORD " already exists\n", pc);
+    return false;
+  }
+  if (nr_breakpoint == NR_BP) {
+    printf("Error: No free breakpoints available\n");
+    return false;
+  }
+  bps[nr_breakpoint ++] = (BP) { .NO = next_NO ++, .pc = pc };
+  rebuild_table();
+  printf("Breakpoint %d at " FMT_WORD "\n", bps[nr_breakpoint - 1].NO, pc);
+  return true;
+}
+
+void delete_breakpoint(int NO) {
+  int i;
+  for (i = 0; i < nr_breakpoint && bps[i].NO != NO; i ++);
+  if (i == nr_breakpoint) {
+    printf("Error: Breakpoint not found\n");
+    return;
+  }
+  bps[i] = bps[-- nr_breakpoint];
+  rebuild_table();
+}
+
+bool breakpoint_hit(vaddr_t pc) {
+  int i = bp_find(pc);
+  if (i == -1) return false;
+  bps[i].hits ++;
+  printf("\e[1;36mBreakpoint %d at " FMT_WORD "\e[0m\n", bps[i].NO, pc);
+  log_write("[breakpoint] %d at " FMT_WORD "\n", bps[i].NO, pc);
+  return true;
+}
+
+void breakpoint_display() {
+  if (nr_breakpoint == 0) {
+    printf("No breakpoint found.\n");
+    return;
+  }
+  printf("NO.\tAddress\t\tHits\n");
+  for (int i = 0; i < nr_breakpoint; i ++) {
+    printf("\e[1;36m%d\e[0m\t" FMT_WORD "\t%" PRIu64 "\n", bps[i].NO, bps[i].pc, bps[i].hits);
+  }
+}
+
+void init_bp_pool() {
+  rebuild_table();
+}
+#endif
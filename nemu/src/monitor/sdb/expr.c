@@ -239,8 +239,20 @@ int get_main_operator(int p, int q) {
   return main_operator;
 }
 
+/* An expression is compiled into a postfix code by emit(), and the code
+ * is run on a small stack by expr_eval(). Registers are resolved to the
+ * address of their storage at compile time, so a watchpoint does not go
+ * through the tokenizer again when it is checked.
+ */
+enum { OP_IMM, OP_REG, OP_PC, OP_DEREF, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_EQ, OP_NOTEQ, OP_LGAND };
+
+static void emit_op(ExprCode *code, int op, word_t *reg, word_t imm) {
+  Assert(code->len < MAX_TOKENS, "exp with too much tokens!");
+  code->inst[code->len ++] = (ExprInst) { .op = op, .reg = reg, .imm = imm };
+}
+
 // p , q are range of index of tokens, which is [p , q)
-int eval(int p, int q, bool *success) {
+static bool emit(int p, int q, ExprCode *code) {
   if (p >= q) {
     /* Bad expression or no tokens found */
     Assert(0, "[TMP] Bad expression!");
@@ -255,31 +267,36 @@ int eval(int p, int q, bool *success) {
     switch (tokens[p].type){
     case TK_HEXNUM:
       sscanf(tokens[p].str, "%x", &buffer);
+      emit_op(code, OP_IMM, NULL, buffer);
       break;
     case TK_DECIMAL:
       sscanf(tokens[p].str, "%u", &buffer);
+      emit_op(code, OP_IMM, NULL, buffer);
       break;
     case TK_REG: {
       if (strcmp(tokens[p].str, "$pc") == 0){
-        buffer = cpu.pc;
-      }else {
-        buffer = isa_reg_str2val(tokens[p].str, success);
+        emit_op(code, OP_PC, NULL, 0);
+        break;
       }
-      if (!*success){
+      int idx = isa_reg_str2idx(tokens[p].str);
+      if (idx == -1){
         printf("isa_reg_str2val() failed!\n");
-        return 0;
+        return false;
       }
+      emit_op(code, OP_REG, &cpu.gpr[idx], 0);
       break;
     }
     default:
       Assert(0, "Invalid expression!");
     }
-    return buffer;
+    return true;
   }
   else if (p + 2 == q || check_parentheses(p + 1, q) == true){//长度为2的子表达式呈型于解引用 "*" <expr>  或 负数(暂未实现)
     switch (tokens[p].type) {
     case TK_DEREF:
-      return *((uint32_t *)guest_to_host(eval(p + 1, q, success)));
+      if (!emit(p + 1, q, code)) return false;
+      emit_op(code, OP_DEREF, NULL, 0);
+      return true;
     default:
       Assert(0, "Invalid expression! expr length2");
     }
@@ -288,44 +305,68 @@ int eval(int p, int q, bool *success) {
     /* The expression is surrounded by a matched pair of parentheses.
      * If that is the case, just throw away the parentheses.
      */
-    return eval(p + 1, q - 1, success);
+    return emit(p + 1, q - 1, code);
   }
   else {
     int op = get_main_operator(p, q);
     Assert(op != INVALID_OP_INDEX, "Unexpected: it's impossible...1");
 
-    int val1 = eval(p, op, success);
-    int val2 = eval(op + 1, q, success);
+    if (!emit(p, op, code) || !emit(op + 1, q, code)) return false;
 
     switch (tokens[op].type) {
-      case '+': return val1 + val2;
-      case '-': return val1 - val2;
-      case '*': return val1 * val2;
-      case '/': {
+      case '+': emit_op(code, OP_ADD, NULL, 0); break;
+      case '-': emit_op(code, OP_SUB, NULL, 0); break;
+      case '*': emit_op(code, OP_MUL, NULL, 0); break;
+      case '/': emit_op(code, OP_DIV, NULL, 0); break;
+      case TK_EQ: emit_op(code, OP_EQ, NULL, 0); break;
+      case TK_NOTEQ: emit_op(code, OP_NOTEQ, NULL, 0); break;
+      case TK_LGAND: emit_op(code, OP_LGAND, NULL, 0); break;
+      default: assert(0);
+    }
+    return true;
+  }
+}
+
+word_t expr_eval(const ExprCode *code, bool *success) {
+  int stack[MAX_TOKENS];
+  int sp = 0;
+  *success = true;
+  for (const ExprInst *i = code->inst, *end = i + code->len; i < end; i ++) {
+    switch (i->op) {
+      case OP_IMM: stack[sp ++] = i->imm; continue;
+      case OP_REG: stack[sp ++] = *i->reg; continue;
+      case OP_PC: stack[sp ++] = cpu.pc; continue;
+      case OP_DEREF: stack[sp - 1] = *((uint32_t *)guest_to_host(stack[sp - 1])); continue;
+    }
+    int val2 = stack[-- sp];
+    int *val1 = &stack[sp - 1];
+    switch (i->op) {
+      case OP_ADD: *val1 = *val1 + val2; break;
+      case OP_SUB: *val1 = *val1 - val2; break;
+      case OP_MUL: *val1 = *val1 * val2; break;
+      case OP_DIV: {
         if (val2 == 0) {
           printf("Divided by zero, Invalid expression!\n");
           *success = false;
           return 0;
         }
-        return val1 / val2;
+        *val1 = *val1 / val2;
+        break;
       }
-      case TK_EQ: return val1 == val2;
-      case TK_NOTEQ: return val1 != val2;
-      case TK_LGAND: return val1 && val2;
+      case OP_EQ: *val1 = *val1 == val2; break;
+      case OP_NOTEQ: *val1 = *val1 != val2; break;
+      case OP_LGAND: *val1 = *val1 && val2; break;
       default: assert(0);
     }
   }
+  return (word_t)stack[0];
 }
 
-word_t expr(char *e, bool *success) {
-  *success = true;
+bool expr_compile(char *e, ExprCode *code) {
   if (!make_token(e)) {
-    *success = false;
-    return 0;
+    return false;
   }
 
-  /* TODO: Insert codes to evaluate the expression. */
-
   // 框架代码++，识别解引用
   int i;
   for (i = 0; i < nr_token; i ++) {
@@ -338,11 +379,17 @@ word_t expr(char *e, bool *success) {
     }
   }
 
-  int output = eval(0, nr_token, success);
+  code->len = 0;
+  bool ok = emit(0, nr_token, code);
+  nr_token = 0;    // clear record
+  return ok;
+}
+
+word_t expr(char *e, bool *success) {
+  ExprCode code;
+  *success = expr_compile(e, &code);
   if (*success == false) {
     return 0;
   }
-  *success = true;
-  nr_token = 0;    // clear record
-  return (word_t)output;
+  return expr_eval(&code, success);
 }
@@ -15,7 +15,9 @@
 
 #include <isa.h>
 #include <cpu/cpu.h>
-#include <memory/vaddr.h>  // should be included for "Scan memory"???
+#include <cpu/decode.h>
+#include <memory/paddr.h>
+#include <memory/host.h>
 #include <readline/readline.h>
 #include <readline/history.h>
 #include "sdb.h"
@@ -24,6 +26,7 @@ static int is_batch_mode = false;
 
 void init_regex();
 void init_wp_pool();
+void init_bp_pool();
 
 /* We use the `readline' library to provide more flexibility to read from stdin. */
 static char* rl_gets() {
@@ -60,7 +63,11 @@ static int cmd_info(char *args);
 static int cmd_x(char *args);
 static int cmd_p(char *args);
 static int cmd_w(char *args);
+IFDEF(CONFIG_WATCHPOINT, static int cmd_dw(char *args));
+IFDEF(CONFIG_BREAKPOINT, static int cmd_b(char *args));
+IFDEF(CONFIG_BREAKPOINT, static int cmd_bd(char *args));
 static int cmd_d(char *args);
+IFDEF(CONFIG_TRACE_TRIGGER, static int cmd_trace(char *args));
 
 static struct {
   const char *name;
@@ -75,7 +82,17 @@ static struct {
   { "x", "Scan memory", cmd_x },
   { "p", "Calculate expression", cmd_p },
   { "w", "Set watch point", cmd_w },
+#ifdef CONFIG_WATCHPOINT
+  { "dw", "Set data watch point on writes to ADDR [LEN], LEN defaults to 4", cmd_dw },
+#endif
   { "d", "Delete watch point", cmd_d },
+#ifdef CONFIG_BREAKPOINT
+  { "b", "Set breakpoint at the value of EXPR, or at a function", cmd_b },
+  { "bd", "Delete breakpoint", cmd_bd },
+#endif
+#ifdef CONFIG_TRACE_TRIGGER
+  { "trace", "Turn tracing on/off now or at pc=, sym=, inst= or write=, 'trace clear' drops the triggers", cmd_trace },
+#endif
   /* TODO: Add more commands */
 
 };
@@ -134,6 +151,16 @@ static int cmd_info(char *args) {
     else if (strcmp(arg, "w") == 0) {
       watchpoint_display();
     }
+#ifdef CONFIG_BREAKPOINT
+    else if (strcmp(arg, "b") == 0) {
+      breakpoint_display();
+    }
+#endif
+#ifdef CONFIG_INSTMIX
+    else if (strcmp(arg, "mix") == 0) {
+      instmix_display();
+    }
+#endif
     else {
       printf("Unknown argument '%s'\n", arg);
     }
@@ -141,6 +168,13 @@ static int cmd_info(char *args) {
   return 0;
 }
 
+/* The debugger is not the guest: read pmem directly so that its reads are
+ * not counted by the cache simulator, MTRACE or the plugins. */
+static word_t sdb_read(paddr_t addr, int len) {
+  if (in_pmem(addr)) return host_read(guest_to_host(addr), len);
+  return paddr_read(addr, len);
+}
+
 static int cmd_x(char *args) {
   char *arg = strtok(NULL, " ");
 
@@ -163,7 +197,7 @@ static int cmd_x(char *args) {
         /* 
           [maybe todo]: 这里按字节顺序由低地址向高地址打印，结果与cpu_exec()打印的顺序相反
         */
-        word_t value = vaddr_read(addr, 1);
+        word_t value = sdb_read(addr, 1);
         printf("%02x ", value);
         addr += 1;
       }
@@ -205,6 +239,24 @@ static int cmd_w(char *args) {
   return 0;
 }
 
+#ifdef CONFIG_WATCHPOINT
+static int cmd_dw(char *args) {
+  char *arg = strtok(NULL, " ");
+  if (arg == NULL) {
+    printf("Wrong usage of dw, missing address\n");
+    return 0;
+  }
+  char *len_arg = strtok(NULL, " ");
+  char *end;
+  paddr_t addr = strtoul(arg, &end, 0);
+  int len = (len_arg ? strtol(len_arg, NULL, 0) : 4);
+  if (*end != '\0' || !add_data_watchpoint(addr, len)) {
+    printf("cmd_dw failed\n");
+  }
+  return 0;
+}
+#endif
+
 static int cmd_d(char *args) {
   char *arg = strtok(NULL, " ");
   if (arg == NULL) {
@@ -222,6 +274,53 @@ static int cmd_d(char *args) {
   return 0;
 }
 
+#ifdef CONFIG_TRACE_TRIGGER
+static int cmd_trace(char *args) {
+  char *action = strtok(NULL, " ");
+  char *cond = strtok(NULL, " ");
+  if (action == NULL) trigger_display();
+  else if (strcmp(action, "clear") == 0) trigger_clear();
+  else trigger_add(action, cond);
+  return 0;
+}
+#endif
+
+#ifdef CONFIG_BREAKPOINT
+static int cmd_b(char *args) {
+  if (args == NULL) {
+    printf("Wrong usage of b, missing expression\n");
+    return 0;
+  }
+  vaddr_t pc;
+#ifdef CONFIG_SYMTAB
+  if (symtab_find_name(args, &pc)) {
+    add_breakpoint(pc);
+    return 0;
+  }
+#endif
+  bool success;
+  pc = expr(args, &success);
+  if (!success) {
+    printf("cmd_b failed\n");
+    return 0;
+  }
+  add_breakpoint(pc);
+  return 0;
+}
+
+static int cmd_bd(char *args) {
+  char *arg = strtok(NULL, " ");
+  char *endptr;
+  int n = (arg ? strtol(arg, &endptr, 10) : 0);
+  if (arg == NULL || endptr == arg || *endptr != '\0') {
+    printf("Wrong usage of bd, missing breakpoint number\n");
+    return 0;
+  }
+  delete_breakpoint(n);
+  return 0;
+}
+#endif
+
 void sdb_set_batch_mode() {
   is_batch_mode = true;
 }
@@ -314,4 +413,7 @@ void init_sdb() {
 
   /* Initialize the watchpoint pool. */
   init_wp_pool();
+
+  /* Initialize the breakpoint set. */
+  IFDEF(CONFIG_BREAKPOINT, init_bp_pool());
 }
@@ -25,6 +25,21 @@
 #define MAX_EXPR_LEN  MAX_TOKENS*4  // 假设每个token对应原表达式的4个字符。
 word_t expr(char *e, bool *success);
 
+// an expression compiled by expr_compile(), see expr.c
+typedef struct {
+  int op;
+  word_t *reg;
+  word_t imm;
+} ExprInst;
+
+typedef struct {
+  int len;
+  ExprInst inst[MAX_TOKENS];
+} ExprCode;
+
+bool expr_compile(char *e, ExprCode *code);
+word_t expr_eval(const ExprCode *code, bool *success);
+
 /*
  ############ for watchpoint ##############
 */
@@ -35,13 +50,26 @@ typedef struct watchpoint {
   /* TODO: Add more members if necessary */
   uint32_t value;
   char expr[MAX_EXPR_LEN];
+  ExprCode code;
+  bool is_data;        // a data watchpoint on [lo, hi] instead of an expression
+  paddr_t lo, hi;
 } WP;
 
 bool add_watchpoint(const char *args, uint32_t value);
+bool add_data_watchpoint(paddr_t addr, int len);
 void delete_watchpoint(int NO);
 bool check_watchpoint(); // 同gdb，打印所有表达式值出现变动的watchpoint
 void watchpoint_display();
 
+/*
+ ############ for breakpoint ##############
+*/
+extern int nr_breakpoint;
+bool add_breakpoint(vaddr_t pc);
+void delete_breakpoint(int NO);
+bool breakpoint_hit(vaddr_t pc); // the next instruction is at a breakpoint
+void breakpoint_display();
+
 
 
 #endif
@@ -13,6 +13,9 @@
 * See the Mulan PSL v2 for more details.
 ***************************************************************************************/
 
+#include <isa.h>
+#include <memory/paddr.h>
+#include <memory/host.h>
 #include "sdb.h"
 
 #define NR_WP 32
@@ -79,10 +82,61 @@ bool add_watchpoint(const char *args, uint32_t value) {
   }
   WP* p = new_wp();
   strcpy(p->expr, args);
+  p->is_data = false;
+  if (!expr_compile(p->expr, &p->code)) {
+    free_wp(p);
+    return false;
+  }
   p->value = value;
   return true;
 }
 
+#ifdef CONFIG_WATCHPOINT
+/* Data watchpoints are checked by paddr_write() before the data is written,
+ * only for writes starting in a page marked in dwatch_page. A write of at
+ * most 8 bytes overlapping [lo, hi] starts in [lo - 7, hi], so the pages of
+ * that range are marked.
+ */
+uint8_t dwatch_page[(CONFIG_MSIZE >> DWATCH_PAGE_SHIFT) / 8 + 1] = {};
+static bool dwatch_hit = false;
+
+static void dwatch_update_pages() {
+  memset(dwatch_page, 0, sizeof(dwatch_page));
+  for (WP *p = head; p != NULL; p = p->next) {
+    if (!p->is_data) continue;
+    paddr_t lo = (p->lo - PMEM_LEFT < 7 ? PMEM_LEFT : p->lo - 7);
+    uint32_t first = (lo - PMEM_LEFT) >> DWATCH_PAGE_SHIFT, last = (p->hi - PMEM_LEFT) >> DWATCH_PAGE_SHIFT;
+    for (uint32_t i = first; i <= last; i ++) dwatch_page[i >> 3] |= 1 << (i & 7);
+  }
+}
+
+bool add_data_watchpoint(paddr_t addr, int len) {
+  paddr_t hi = addr + len - 1;
+  if (len <= 0 || !in_pmem(addr) || !in_pmem(hi) || hi < addr) {
+    printf("Data watchpoint must be inside pmem [" FMT_PADDR ", " FMT_PADDR "]\n", PMEM_LEFT, PMEM_RIGHT);
+    return false;
+  }
+  WP* p = new_wp();
+  p->is_data = true;
+  p->lo = addr;
+  p->hi = hi;
+  snprintf(p->expr, sizeof(p->expr), "write [" FMT_PADDR ", " FMT_PADDR "]", addr, hi);
+  dwatch_update_pages();
+  return true;
+}
+
+void dwatch_write(paddr_t addr, int len, word_t data) {
+  for (WP *p = head; p != NULL; p = p->next) {
+    if (!p->is_data || addr > p->hi || addr + len - 1 < p->lo) continue;
+    printf("nemu watchpoint %d: %s\n", p->NO, p->expr);
+    printf("\tpc = " FMT_WORD ", %d bytes at " FMT_PADDR "\n", cpu.pc, len, addr);
+    printf("\tOld value = " FMT_WORD "\n\tNew value = " FMT_WORD "\n",
+        host_read(guest_to_host(addr), len), data);
+    dwatch_hit = true;
+  }
+}
+#endif
+
 void delete_watchpoint(int NO) {  // 这里其实是O(NR_WP^2)复杂度,可优化
   WP *p = head;
   while (p != NULL && p->NO != NO) {
@@ -93,14 +147,20 @@ void delete_watchpoint(int NO) {  // 这里其实是O(NR_WP^2)复杂度,可优
       return;
   }
   free_wp(p);
+  IFDEF(CONFIG_WATCHPOINT, if (p->is_data) dwatch_update_pages());
 }
 
 bool check_watchpoint() {
   WP *p = head;
   bool success = true;
   bool changed = false;
+#ifdef CONFIG_WATCHPOINT
+  changed = dwatch_hit;
+  dwatch_hit = false;
+#endif
   while (p){
-    uint32_t value = expr(p->expr, &success);
+    if (p->is_data) { p = p->next; continue; }
+    uint32_t value = expr_eval(&p->code, &success);
     if (value != p->value || !success){
       changed = true;
       printf("nemu watchpoint %d: %s\n", p->NO, p->expr);
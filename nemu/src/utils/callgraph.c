@@ -0,0 +1,437 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <common.h>
+
+#if defined(CONFIG_CALLGRAPH) || defined(CONFIG_PCSAMPLE)
+// open addressing hash table from 64-bit keys to indices, -1 means empty
+typedef struct {
+  uint64_t *key;
+  int *val;
+  uint32_t cap, size;
+} Map;
+
+static inline uint32_t hash64(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdull;
+  key ^= key >> 33;
+  return key;
+}
+
+static int map_get(Map *m, uint64_t key) {
+  if (m->cap == 0) return -1;
+  for (uint32_t i = hash64(key) & (m->cap - 1); ; i = (i + 1) & (m->cap - 1)) {
+    if (m->val[i] == -1) return -1;
+    if (m->key[i] == key) return m->val[i];
+  }
+}
+
+static void map_put(Map *m, uint64_t key, int val) {
+  if (2 * (m->size + 1) > m->cap) {
+    Map old = *m;
+    m->cap = old.cap ? old.cap * 2 : 1024;
+    m->size = 0;
+    m->key = malloc(sizeof(m->key[0]) * m->cap);
+    m->val = malloc(sizeof(m->val[0]) * m->cap);
+    Assert(m->key && m->val, "out of memory");
+    memset(m->val, -1, sizeof(m->val[0]) * m->cap);
+    for (uint32_t i = 0; i < old.cap; i ++) {
+      if (old.val[i] != -1) map_put(m, old.key[i], old.val[i]);
+    }
+    free(old.key);
+    free(old.val);
+  }
+  uint32_t i = hash64(key) & (m->cap - 1);
+  while (m->val[i] != -1) i = (i + 1) & (m->cap - 1);
+  m->key[i] = key;
+  m->val[i] = val;
+  m->size ++;
+}
+
+#define GROW(arr, nr, cap) do { \
+  if ((nr) == (cap)) { \
+    (cap) = (cap) ? (cap) * 2 : 256; \
+    (arr) = realloc((arr), sizeof((arr)[0]) * (cap)); \
+    Assert((arr), "out of memory"); \
+  } \
+} while (0)
+
+#endif
+
+#ifdef CONFIG_CALLGRAPH
+/* Call graph profiler.
+ * Calls and returns reported by the ISA drive a shadow call stack. Every
+ * frame remembers the instruction count when it was entered and the
+ * inclusive counts of the callees which have already returned, so a
+ * return charges the function and the caller->callee edge with both its
+ * self and inclusive counts. Functions are keyed by the start of their
+ * symbol, or by the call target when there is no symbol for it.
+ */
+extern uint64_t g_nr_guest_inst;
+
+typedef struct {
+  vaddr_t addr;
+  const char *name; // NULL if there is no symbol
+  uint64_t self, incl, calls;
+  int active;       // frames of this function on the shadow stack
+} Func;
+
+typedef struct {
+  int caller, callee;
+  uint64_t count, self, incl;
+} Edge;
+
+typedef struct {
+  int func, edge;   // edge is -1 for the root frame
+  uint64_t enter;   // g_nr_guest_inst when the frame is entered
+  uint64_t child;   // inclusive counts of the returned callees
+} Frame;
+
+static Func *funcs = NULL;
+static int nr_func = 0, cap_func = 0;
+static Edge *edges = NULL;
+static int nr_edge = 0, cap_edge = 0;
+static Frame *stack = NULL;
+static int depth = 0, cap_stack = 0;
+static Map func_map = {}, edge_map = {};
+
+static int func_of(vaddr_t addr) {
+  vaddr_t start = addr;
+  const char *name = symtab_lookup(addr, &start);
+  int idx = map_get(&func_map, start);
+  if (idx == -1) {
+    GROW(funcs, nr_func, cap_func);
+    idx = nr_func ++;
+    funcs[idx] = (Func) { .addr = start, .name = name };
+    map_put(&func_map, start, idx);
+  }
+  return idx;
+}
+
+static int edge_of(int caller, int callee) {
+  uint64_t key = ((uint64_t)caller << 32) | (uint32_t)callee;
+  int idx = map_get(&edge_map, key);
+  if (idx == -1) {
+    GROW(edges, nr_edge, cap_edge);
+    idx = nr_edge ++;
+    edges[idx] = (Edge) { .caller = caller, .callee = callee };
+    map_put(&edge_map, key, idx);
+  }
+  return idx;
+}
+
+static void push(int func, int edge, uint64_t enter) {
+  GROW(stack, depth, cap_stack);
+  stack[depth ++] = (Frame) { .func = func, .edge = edge, .enter = enter };
+  funcs[func].active ++;
+}
+
+static void pop(uint64_t now) {
+  Frame *f = &stack[-- depth];
+  uint64_t incl = now - f->enter;
+  uint64_t self = incl - f->child;
+  Func *fn = &funcs[f->func];
+  fn->self += self;
+  // recursive activations are already included by the outermost one
+  if (-- fn->active == 0) fn->incl += incl;
+  if (f->edge != -1) {
+    edges[f->edge].self += self;
+    edges[f->edge].incl += incl;
+  }
+  if (depth > 0) stack[depth - 1].child += incl;
+}
+
+// the function running before the first call becomes the root,
+// which is charged with everything since the beginning
+static void check_root(vaddr_t pc) {
+  if (depth == 0) push(func_of(pc), -1, 0);
+}
+
+// the hooks run while the call or return instruction is executing, and it
+// is not counted yet; charge it to the function it belongs to
+#define NOW (g_nr_guest_inst + 1)
+
+void callgraph_call(vaddr_t pc, vaddr_t target, bool is_tail_call) {
+  check_root(pc);
+  if (is_tail_call) {
+    // `jr' also implements jump tables inside a function, it is only a
+    // tail call when the target is in another function
+    vaddr_t start = target;
+    if (symtab_lookup(target, &start) == NULL || start == funcs[stack[depth - 1].func].addr) return;
+    // a tail call replaces the caller, the callee returns to the caller's caller
+    if (depth > 1) pop(NOW);
+  }
+  int callee = func_of(target);
+  int edge = edge_of(stack[depth - 1].func, callee);
+  edges[edge].count ++;
+  funcs[callee].calls ++;
+  push(callee, edge, NOW);
+}
+
+void callgraph_ret(vaddr_t pc, vaddr_t target) {
+  check_root(pc);
+  if (depth == 1) return;
+  // unwind to the function containing the return address, so that frames
+  // skipped by longjmp() and the like are closed; if it is not on the
+  // stack, treat it as a plain return
+  vaddr_t start = target;
+  symtab_lookup(target, &start);
+  int func = map_get(&func_map, start);
+  int d = depth - 2;
+  while (d >= 0 && stack[d].func != func) d --;
+  if (d < 0) d = depth - 2;
+  while (depth > d + 1) pop(NOW);
+}
+
+static const char *func_name(int idx) {
+  static char buf[4][32];
+  static int k = 0;
+  if (funcs[idx].name) return funcs[idx].name;
+  k = (k + 1) % 4;
+  snprintf(buf[k], sizeof(buf[k]), FMT_WORD, funcs[idx].addr);
+  return buf[k];
+}
+
+
+static int *rank = NULL; // index of each function in the call graph section
+
+static int cmp_self(const void *a, const void *b) {
+  const Func *x = &funcs[*(const int *)a], *y = &funcs[*(const int *)b];
+  return (x->self < y->self) - (x->self > y->self);
+}
+
+static int cmp_incl(const void *a, const void *b) {
+  const Func *x = &funcs[*(const int *)a], *y = &funcs[*(const int *)b];
+  return (x->incl < y->incl) - (x->incl > y->incl);
+}
+
+static int cmp_edge_incl(const void *a, const void *b) {
+  const Edge *x = &edges[*(const int *)a], *y = &edges[*(const int *)b];
+  return (x->incl < y->incl) - (x->incl > y->incl);
+}
+
+// group the edges by one end, each group sorted by inclusive count
+static void group_edges(int *order, int *begin, bool by_callee) {
+  memset(begin, 0, sizeof(begin[0]) * (nr_func + 1));
+  for (int i = 0; i < nr_edge; i ++) begin[(by_callee ? edges[i].callee : edges[i].caller) + 1] ++;
+  for (int i = 0; i < nr_func; i ++) begin[i + 1] += begin[i];
+  int *pos = malloc(sizeof(int) * nr_func);
+  memcpy(pos, begin, sizeof(int) * nr_func);
+  for (int i = 0; i < nr_edge; i ++) order[pos[by_callee ? edges[i].callee : edges[i].caller] ++] = i;
+  for (int i = 0; i < nr_func; i ++) qsort(order + begin[i], begin[i + 1] - begin[i], sizeof(int), cmp_edge_incl);
+  free(pos);
+}
+
+static void write_gprof(const char *path, uint64_t total) {
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) { Log("can not open '%s' for the call graph profile", path); return; }
+  double scale = total ? 100.0 / total : 0;
+  int *order = malloc(sizeof(int) * nr_func);
+  for (int i = 0; i < nr_func; i ++) order[i] = i;
+
+  qsort(order, nr_func, sizeof(int), cmp_self);
+  fprintf(fp, "Flat profile:\n\nEach sample counts as 1 instruction.\n");
+  fprintf(fp, "  %%   cumulative       self                   self      total\n");
+  fprintf(fp, " time      instrs     instrs      calls  instrs/call instrs/call  name\n");
+  uint64_t cum = 0;
+  for (int i = 0; i < nr_func; i ++) {
+    Func *f = &funcs[order[i]];
+    if (f->self == 0 && f->calls == 0) continue;
+    cum += f->self;
+    fprintf(fp, "%6.2f %11" PRIu64 " %10" PRIu64 " %10" PRIu64, f->self * scale, cum, f->self, f->calls);
+    if (f->calls) fprintf(fp, " %12.2f %11.2f", (double)f->self / f->calls, (double)f->incl / f->calls);
+    else fprintf(fp, " %12s %11s", "", "");
+    fprintf(fp, "  %s\n", func_name(order[i]));
+  }
+
+  qsort(order, nr_func, sizeof(int), cmp_incl);
+  for (int i = 0; i < nr_func; i ++) rank[order[i]] = i + 1;
+  int *in = malloc(sizeof(int) * (nr_edge + 1)), *in_begin = malloc(sizeof(int) * (nr_func + 1));
+  int *out = malloc(sizeof(int) * (nr_edge + 1)), *out_begin = malloc(sizeof(int) * (nr_func + 1));
+  group_edges(in, in_begin, true);
+  group_edges(out, out_begin, false);
+
+  fprintf(fp, "\n\nCall graph:\n\n");
+  fprintf(fp, "index  %% time       self   children      called      name\n");
+  for (int i = 0; i < nr_func; i ++) {
+    int idx = order[i];
+    Func *f = &funcs[idx];
+    for (int j = in_begin[idx]; j < in_begin[idx + 1]; j ++) {
+      Edge *e = &edges[in[j]];
+      fprintf(fp, "%15s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "/%-10" PRIu64 "    %s [%d]\n", "",
+          e->self, e->incl - e->self, e->count, f->calls, func_name(e->caller), rank[e->caller]);
+    }
+    char index[16];
+    snprintf(index, sizeof(index), "[%d]", i + 1);
+    fprintf(fp, "%-6s %6.1f %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "            %s %s\n",
+        index, f->incl * scale, f->self, f->incl - f->self, f->calls, func_name(idx), index);
+    for (int j = out_begin[idx]; j < out_begin[idx + 1]; j ++) {
+      Edge *e = &edges[out[j]];
+      fprintf(fp, "%15s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "/%-10" PRIu64 "        %s [%d]\n", "",
+          e->self, e->incl - e->self, e->count, funcs[e->callee].calls, func_name(e->callee), rank[e->callee]);
+    }
+    fprintf(fp, "-----------------------------------------------\n");
+  }
+  free(in); free(in_begin); free(out); free(out_begin);
+  free(order);
+  fclose(fp);
+}
+
+static void write_callgrind(const char *path, uint64_t total) {
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) { Log("can not open '%s' for the callgrind output", path); return; }
+  fprintf(fp, "# callgrind format\nversion: 1\ncreator: nemu\npositions: line\n");
+  fprintf(fp, "events: Ir\nsummary: %" PRIu64 "\n", total);
+  // name compression: the first occurrence defines "(id) name", later ones use "(id)"
+  bool *named = calloc(nr_func, sizeof(bool));
+#define FN(key, i) do { \
+  if (named[i]) fprintf(fp, key "=(%d)\n", (i) + 1); \
+  else { fprintf(fp, key "=(%d) %s\n", (i) + 1, func_name(i)); named[i] = true; } \
+} while (0)
+  int *out = malloc(sizeof(int) * (nr_edge + 1)), *out_begin = malloc(sizeof(int) * (nr_func + 1));
+  group_edges(out, out_begin, false);
+  for (int i = 0; i < nr_func; i ++) {
+    fprintf(fp, "\n");
+    FN("fn", i);
+    fprintf(fp, "0 %" PRIu64 "\n", funcs[i].self);
+    for (int j = out_begin[i]; j < out_begin[i + 1]; j ++) {
+      Edge *e = &edges[out[j]];
+      FN("cfn", e->callee);
+      fprintf(fp, "calls=%" PRIu64 " 0\n0 %" PRIu64 "\n", e->count, e->incl);
+    }
+  }
+#undef FN
+  free(out); free(out_begin);
+  free(named);
+  fclose(fp);
+}
+
+void callgraph_report() {
+  static bool reported = false;
+  if (reported) return;
+  reported = true;
+  if (depth == 0) return;
+  uint64_t total = g_nr_guest_inst - stack[0].enter;
+  while (depth > 0) pop(g_nr_guest_inst);
+  rank = malloc(sizeof(int) * nr_func);
+  write_gprof(CONFIG_CALLGRAPH_FILE, total);
+  write_callgrind(CONFIG_CALLGRAPH_CALLGRIND_FILE, total);
+  free(rank);
+  Log("call graph profile of %d functions written to %s and %s",
+      nr_func, CONFIG_CALLGRAPH_FILE, CONFIG_CALLGRAPH_CALLGRIND_FILE);
+}
+#endif
+
+#ifdef CONFIG_PCSAMPLE
+/* The pc sampler keeps its own shadow stack, which only records the entry
+ * of each called function, so calls and returns cost a store each and the
+ * sampler does not pay for the call graph profiler. The entries are mapped
+ * to functions by the symbol table when a sample is taken. A `jr' inside a
+ * function replaces the top entry with an address of the same function, so
+ * jump tables need no special care.
+ */
+#define PCSAMPLE_STACK 1024
+
+static vaddr_t sample_stack[PCSAMPLE_STACK];
+static int sample_depth = 0; // may exceed PCSAMPLE_STACK, deeper frames are not recorded
+
+void pcsample_call(vaddr_t pc, vaddr_t target, bool is_tail_call) {
+  // the function running before the first call becomes the root
+  if (sample_depth == 0) sample_stack[sample_depth ++] = pc;
+  // a tail call replaces the caller
+  if (is_tail_call) sample_depth --;
+  if (sample_depth < PCSAMPLE_STACK) sample_stack[sample_depth] = target;
+  sample_depth ++;
+}
+
+void pcsample_ret() {
+  if (sample_depth > 1) sample_depth --;
+}
+
+/* Sampled stacks are kept in a trie: a node is a function called from its
+ * parent node, and counts the samples whose stack ends there.
+ */
+typedef struct {
+  int parent;
+  vaddr_t func;     // start of the function, or the address without a symbol
+  uint64_t count;
+} Node;
+
+static Node *nodes = NULL;
+static int nr_node = 0, cap_node = 0;
+static Map node_map = {};
+uint64_t pcsample_next = CONFIG_PCSAMPLE_INTERVAL;
+
+static vaddr_t sample_func(vaddr_t addr) {
+  vaddr_t start = addr;
+  symtab_lookup(addr, &start);
+  return start;
+}
+
+static int node_of(int parent, vaddr_t func) {
+  uint64_t key = ((uint64_t)(uint32_t)parent << 32) | (uint32_t)func;
+  int idx = map_get(&node_map, key);
+  if (idx == -1) {
+    GROW(nodes, nr_node, cap_node);
+    idx = nr_node ++;
+    nodes[idx] = (Node) { .parent = parent, .func = func };
+    map_put(&node_map, key, idx);
+  }
+  return idx;
+}
+
+void pcsample(vaddr_t pc) {
+  pcsample_next += CONFIG_PCSAMPLE_INTERVAL;
+  int node = -1;
+  vaddr_t top = 0;
+  int depth = (sample_depth < PCSAMPLE_STACK ? sample_depth : PCSAMPLE_STACK);
+  for (int i = 0; i < depth; i ++) {
+    top = sample_func(sample_stack[i]);
+    node = node_of(node, top);
+  }
+  vaddr_t leaf = sample_func(pc);
+  if (depth == 0 || top != leaf) node = node_of(node, leaf);
+  nodes[node].count ++;
+}
+
+static void write_folded_stack(FILE *fp, int node) {
+  if (nodes[node].parent != -1) {
+    write_folded_stack(fp, nodes[node].parent);
+    fputc(';', fp);
+  }
+  const char *name = symtab_lookup(nodes[node].func, NULL);
+  if (name) fputs(name, fp);
+  else fprintf(fp, FMT_WORD, nodes[node].func);
+}
+
+void pcsample_report() {
+  static bool reported = false;
+  if (reported) return;
+  reported = true;
+  const char *path = CONFIG_PCSAMPLE_FILE;
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) { Log("can not open '%s' for the pc samples", path); return; }
+  uint64_t total = 0;
+  for (int i = 0; i < nr_node; i ++) {
+    if (nodes[i].count == 0) continue;
+    write_folded_stack(fp, i);
+    fprintf(fp, " %" PRIu64 "\n", nodes[i].count);
+    total += nodes[i].count;
+  }
+  fclose(fp);
+  Log("%" PRIu64 " pc samples written to %s", total, path);
+}
+#endif
@@ -22,6 +22,7 @@
 #include "llvm/MC/MCContext.h"
 #include "llvm/MC/MCDisassembler/MCDisassembler.h"
 #include "llvm/MC/MCInstPrinter.h"
+#include "llvm/MC/MCInstrInfo.h"
 #if LLVM_VERSION_MAJOR >= 14
 #include "llvm/MC/TargetRegistry.h"
 #if LLVM_VERSION_MAJOR >= 15
@@ -31,6 +32,7 @@
 #include "llvm/Support/TargetRegistry.h"
 #endif
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/ADT/SmallString.h"
 
 #if defined(__GNUC__) && !defined(__clang__)
 #pragma GCC diagnostic pop
@@ -45,6 +47,27 @@ using namespace llvm;
 static llvm::MCDisassembler *gDisassembler = nullptr;
 static llvm::MCSubtargetInfo *gSTI = nullptr;
 static llvm::MCInstPrinter *gIP = nullptr;
+static llvm::MCInstrInfo *gMII = nullptr;
+
+/* Guest programs spend their time in loops, so the same instructions are
+ * disassembled over and over. Results are memoized in a direct-mapped
+ * cache keyed on the instruction bytes. Instructions with a PC-relative
+ * operand print a target address, so for them the decoded MCInst is kept
+ * and only re-printed when they are seen at a different pc.
+ */
+#define CACHE_SIZE 4096
+#define CACHE_TEXT_LEN 96
+
+struct CacheEntry {
+  uint64_t bytes;
+  int nbyte;        // 0 for an empty entry
+  bool pcrel;
+  uint64_t pc;      // only meaningful when `pcrel' is true
+  MCInst inst;
+  char text[CACHE_TEXT_LEN];
+};
+
+static CacheEntry cache[CACHE_SIZE];
 
 extern "C" void init_disasm(const char *triple) {
   llvm::InitializeAllTargetInfos();
@@ -55,7 +78,6 @@ extern "C" void init_disasm(const char *triple) {
   std::string errstr;
   std::string gTriple(triple);
 
-  llvm::MCInstrInfo *gMII = nullptr;
   llvm::MCRegisterInfo *gMRI = nullptr;
   auto target = llvm::TargetRegistry::lookupTarget(gTriple, errstr);
   if (!target) {
@@ -92,18 +114,55 @@ extern "C" void init_disasm(const char *triple) {
     gIP->applyTargetSpecificCLOption("no-aliases");
 }
 
-extern "C" void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte) {
-  MCInst inst;
-  llvm::ArrayRef<uint8_t> arr(code, nbyte);
-  uint64_t dummy_size = 0;
-  gDisassembler->getInstruction(inst, dummy_size, arr, pc, llvm::nulls());
+static bool is_pcrel(const MCInst &inst) {
+  const MCInstrDesc &desc = gMII->get(inst.getOpcode());
+  for (const MCOperandInfo &info : desc.operands()) {
+    if (info.OperandType == MCOI::OPERAND_PCREL) return true;
+  }
+  return false;
+}
 
-  std::string s;
-  raw_string_ostream os(s);
+// print into a stack buffer, so that a cache hit never touches the heap
+static void print_inst(char *str, int size, const MCInst &inst, uint64_t pc) {
+  SmallString<128> s;
+  raw_svector_ostream os(s);
   gIP->printInst(&inst, pc, "", *gSTI, os);
 
-  int skip = s.find_first_not_of('\t');
-  const char *p = s.c_str() + skip;
-  assert((int)s.length() - skip < size);
-  strcpy(str, p);
+  StringRef text = s.str().ltrim('\t');
+  assert((int)text.size() < size);
+  memcpy(str, text.data(), text.size());
+  str[text.size()] = '\0';
+}
+
+extern "C" void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte) {
+  if (nbyte > (int)sizeof(uint64_t)) {
+    MCInst inst;
+    uint64_t dummy_size = 0;
+    gDisassembler->getInstruction(inst, dummy_size, ArrayRef<uint8_t>(code, nbyte), pc, nulls());
+    print_inst(str, size, inst, pc);
+    return;
+  }
+
+  uint64_t bytes = 0;
+  memcpy(&bytes, code, nbyte);
+  uint64_t h = (bytes ^ (bytes >> 17) ^ (bytes >> 31) ^ nbyte) * 0x9e3779b97f4a7c15ull;
+  CacheEntry &e = cache[h >> 52 & (CACHE_SIZE - 1)];
+
+  if (e.nbyte != nbyte || e.bytes != bytes) {
+    e.inst.clear();
+    uint64_t dummy_size = 0;
+    gDisassembler->getInstruction(e.inst, dummy_size, ArrayRef<uint8_t>(code, nbyte), pc, nulls());
+    e.bytes = bytes;
+    e.nbyte = nbyte;
+    e.pcrel = is_pcrel(e.inst);
+    print_inst(e.text, sizeof(e.text), e.inst, pc);
+    e.pc = pc;
+  } else if (e.pcrel && e.pc != pc) {
+    print_inst(e.text, sizeof(e.text), e.inst, pc);
+    e.pc = pc;
+  }
+
+  size_t len = strlen(e.text);
+  assert((int)len < size);
+  memcpy(str, e.text, len + 1);
 }
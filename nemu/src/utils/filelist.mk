@@ -18,3 +18,7 @@ CXXSRC = src/utils/disasm.cc
 CXXFLAGS += $(shell llvm-config-11 --cxxflags) -fPIE
 LIBS += $(shell llvm-config-11 --libs)
 endif
+
+ifdef CONFIG_TARGET_NATIVE_ELF
+LIBS += -lpthread
+endif
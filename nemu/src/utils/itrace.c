@@ -0,0 +1,87 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <common.h>
+
+#ifdef CONFIG_ITRACE
+void itrace_format(char *buf, int size, vaddr_t pc, uint8_t *inst, int ilen) {
+  char *p = buf;
+  p += snprintf(p, size, FMT_WORD ":", pc);
+  int i;
+  for (i = ilen - 1; i >= 0; i --) {
+    p += snprintf(p, 4, " %02x", inst[i]); // si 单步调试中的一条指令的内容。
+  }
+  int ilen_max = MUXDEF(CONFIG_ISA_x86, 8, 4);
+  int space_len = ilen_max - ilen;
+  if (space_len < 0) space_len = 0;
+  space_len = space_len * 3 + 1;
+  memset(p, ' ', space_len);
+  p += space_len;
+
+#ifndef CONFIG_ISA_loongarch32r
+  // s反汇编，打印 si 二进制指令对应的汇编指令。
+  void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte);
+  disassemble(p, buf + size - p, MUXDEF(CONFIG_ISA_x86, pc + ilen, pc), inst, ilen);
+#else
+  p[0] = '\0'; // the upstream llvm does not support loongarch32r
+#endif
+}
+#endif
+
+#ifdef CONFIG_ITRACE_BINARY
+#include <trace-def.h>
+
+#define REC_SIZE ITRACE_REC_SIZE(sizeof(vaddr_t))
+#define BUF_SIZE (1024 * 1024 / REC_SIZE * REC_SIZE)
+
+static uint8_t buf[BUF_SIZE];
+static size_t len = 0;
+static FILE *fp = NULL;
+
+void itrace_flush() {
+  if (fp != NULL && len > 0) {
+    fwrite(buf, 1, len, fp);
+    IFDEF(CONFIG_TELEMETRY, trace_bytes += len);
+    fflush(fp);
+    len = 0;
+  }
+}
+
+void itrace_write(vaddr_t pc, uint32_t inst) {
+  if (unlikely(len == BUF_SIZE)) itrace_flush();
+  memcpy(buf + len, &pc, sizeof(pc));
+  memcpy(buf + len + sizeof(pc), &inst, sizeof(inst));
+  len += REC_SIZE;
+}
+
+void init_itrace() {
+  const char *file = CONFIG_ITRACE_BINARY_FILE;
+  fp = fopen(file, "wb");
+  Assert(fp, "Can not open '%s'", file);
+
+  TraceHeader h = {
+    .magic = TRACE_MAGIC,
+    .version = TRACE_VERSION,
+    .type = TRACE_TYPE_ITRACE,
+    .word_size = sizeof(vaddr_t),
+    .rec_size = REC_SIZE,
+    .triple = DISASM_TRIPLE,
+  };
+  fwrite(&h, sizeof(h), 1, fp);
+  atexit(itrace_flush);
+  Log("Binary instruction trace is written to %s", file);
+}
+#endif
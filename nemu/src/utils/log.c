@@ -18,20 +18,149 @@
 extern uint64_t g_nr_guest_inst;
 
 #ifndef CONFIG_TARGET_AM
+#include <stdarg.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <stdatomic.h>
+
 FILE *log_fp = NULL;
 
+/* When the log goes to a file, messages are formatted into a buffer owned
+ * by the calling thread. Full buffers are pushed to a lock-free MPSC queue
+ * (Vyukov's intrusive queue) and written by a background thread, so the
+ * CPU loop never waits for a write syscall. Logging to stdout stays
+ * synchronous to keep it ordered with the rest of the terminal output.
+ */
+#define LOG_BUF_SIZE (64 * 1024)
+
+typedef struct LogBuf {
+  struct LogBuf *_Atomic next;
+  size_t len, cap;
+  char data[];
+} LogBuf;
+
+static bool async = false;
+static LogBuf stub = {};
+static LogBuf *_Atomic q_head = &stub; // producers push here
+static LogBuf *q_tail = &stub;         // only touched by the writer
+static sem_t q_sem;
+static _Atomic uint64_t nr_submit = 0, nr_done = 0;
+static __thread LogBuf *cur = NULL;
+
+static void q_push(LogBuf *b) {
+  atomic_store_explicit(&b->next, NULL, memory_order_relaxed);
+  LogBuf *prev = atomic_exchange_explicit(&q_head, b, memory_order_acq_rel);
+  atomic_store_explicit(&prev->next, b, memory_order_release);
+}
+
+// return NULL if the queue is empty or a push is still in progress
+static LogBuf *q_pop() {
+  LogBuf *tail = q_tail;
+  LogBuf *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+  if (tail == &stub) {
+    if (next == NULL) return NULL;
+    q_tail = tail = next;
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+  }
+  if (next != NULL) {
+    q_tail = next;
+    return tail;
+  }
+  if (tail != atomic_load_explicit(&q_head, memory_order_acquire)) return NULL;
+  q_push(&stub);
+  next = atomic_load_explicit(&tail->next, memory_order_acquire);
+  if (next != NULL) {
+    q_tail = next;
+    return tail;
+  }
+  return NULL;
+}
+
+static void *log_writer(void *arg) {
+  while (true) {
+    sem_wait(&q_sem);
+    LogBuf *b;
+    // the item is guaranteed to arrive once its push completes
+    while ((b = q_pop()) == NULL) sched_yield();
+    fwrite(b->data, 1, b->len, log_fp);
+    free(b);
+    atomic_fetch_add_explicit(&nr_done, 1, memory_order_release);
+  }
+  return NULL;
+}
+
+static LogBuf *new_buf(size_t cap) {
+  LogBuf *b = malloc(sizeof(LogBuf) + cap);
+  assert(b);
+  b->len = 0;
+  b->cap = cap;
+  return b;
+}
+
+static void submit_cur() {
+  if (cur == NULL || cur->len == 0) return;
+  atomic_fetch_add_explicit(&nr_submit, 1, memory_order_relaxed);
+  q_push(cur);
+  sem_post(&q_sem);
+  cur = NULL;
+}
+
+void log_printf(const char *fmt, ...) {
+  if (log_fp == NULL) return; // not initialized yet
+  va_list ap;
+  va_start(ap, fmt);
+  if (!async) {
+    vfprintf(log_fp, fmt, ap);
+    fflush(log_fp);
+    va_end(ap);
+    return;
+  }
+
+  if (cur == NULL) cur = new_buf(LOG_BUF_SIZE);
+  va_list ap2;
+  va_copy(ap2, ap);
+  size_t room = cur->cap - cur->len;
+  size_t n = vsnprintf(cur->data + cur->len, room, fmt, ap);
+  if (n >= room) {
+    // does not fit, start a new buffer large enough for the message
+    submit_cur();
+    cur = new_buf(n + 1 > LOG_BUF_SIZE ? n + 1 : LOG_BUF_SIZE);
+    vsnprintf(cur->data, cur->cap, fmt, ap2);
+  }
+  cur->len += n;
+  IFDEF(CONFIG_TELEMETRY, trace_bytes += n);
+  va_end(ap2);
+  va_end(ap);
+}
+
+/* Write out everything logged so far by the calling thread. */
+void log_flush() {
+  if (log_fp == NULL) return;
+  if (async) {
+    submit_cur();
+    uint64_t target = atomic_load_explicit(&nr_submit, memory_order_relaxed);
+    while (atomic_load_explicit(&nr_done, memory_order_acquire) < target) sched_yield();
+  }
+  fflush(log_fp);
+}
+
 void init_log(const char *log_file) {
   log_fp = stdout;
   if (log_file != NULL) {
     FILE *fp = fopen(log_file, "w");
     Assert(fp, "Can not open '%s'", log_file);
     log_fp = fp;
+
+    sem_init(&q_sem, 0, 0);
+    pthread_t tid;
+    Assert(pthread_create(&tid, NULL, log_writer, NULL) == 0, "Can not create the log writer thread");
+    async = true;
+    atexit(log_flush);
   }
   Log("Log is written to %s", log_file ? log_file : "stdout");
 }
 
-bool log_enable() {
-  return MUXDEF(CONFIG_TRACE, (g_nr_guest_inst >= CONFIG_TRACE_START) &&
-         (g_nr_guest_inst <= CONFIG_TRACE_END), false);
-}
+// on from the first log line when the default trace window starts at 0
+bool trace_on = MUXDEF(CONFIG_TRACE_TRIGGER, CONFIG_TRACE_START == 0, false);
 #endif
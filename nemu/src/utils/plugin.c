@@ -0,0 +1,137 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <isa.h>
+#include <memory/paddr.h>
+#include <memory/host.h>
+
+#ifdef CONFIG_PLUGIN
+#include <dlfcn.h>
+#include <limits.h>
+#include <nemu-plugin.h>
+
+#define NR_PLUGIN 16
+#define NR_CB     16
+
+uint32_t plugin_events = 0;
+
+static const char *plugin_spec[NR_PLUGIN];
+static int nr_plugin = 0;
+
+#define CB_LIST(type, name) \
+  static struct { type cb; void *udata; } name[NR_CB]; \
+  static int concat(nr_, name) = 0;
+
+CB_LIST(nemu_plugin_block_cb, block_cbs)
+CB_LIST(nemu_plugin_insn_cb,  insn_cbs)
+CB_LIST(nemu_plugin_mem_cb,   mem_cbs)
+CB_LIST(nemu_plugin_dev_cb,   dev_cbs)
+CB_LIST(nemu_plugin_exit_cb,  exit_cbs)
+
+#define REGISTER(name, ev, _cb, _udata) do { \
+  Assert(concat(nr_, name) < NR_CB, "too many plugin callbacks for " #name); \
+  name[concat(nr_, name)].cb = _cb; \
+  name[concat(nr_, name)].udata = _udata; \
+  concat(nr_, name) ++; \
+  plugin_events |= ev; \
+} while (0)
+
+static void register_block_cb(nemu_plugin_block_cb cb, void *udata) { REGISTER(block_cbs, PLUGIN_EV_EXEC, cb, udata); }
+static void register_insn_cb(nemu_plugin_insn_cb cb, void *udata) { REGISTER(insn_cbs, PLUGIN_EV_EXEC, cb, udata); }
+static void register_mem_cb(nemu_plugin_mem_cb cb, void *udata) { REGISTER(mem_cbs, PLUGIN_EV_MEM, cb, udata); }
+static void register_dev_cb(nemu_plugin_dev_cb cb, void *udata) { REGISTER(dev_cbs, PLUGIN_EV_DEV, cb, udata); }
+static void register_exit_cb(nemu_plugin_exit_cb cb, void *udata) { REGISTER(exit_cbs, 0, cb, udata); }
+
+static uint64_t read_reg(const char *name, bool *success) {
+  bool ok = false;
+  word_t val = (strcmp(name, "pc") == 0 ? (ok = true, cpu.pc) : isa_reg_str2val(name, &ok));
+  if (success != NULL) *success = ok;
+  return val;
+}
+
+/* Read pmem directly: going through vaddr_read() would call the mem
+ * callbacks again and show up in the cache simulator and MTRACE as a
+ * guest access. */
+static uint64_t read_mem(uint64_t addr, int len) {
+  if (len != 1 && len != 2 && len != 4 && (len != 8 || sizeof(word_t) < 8)) return 0;
+  if (addr != (paddr_t)addr || !in_pmem(addr) || !in_pmem(addr + len - 1)) return 0;
+  return host_read(guest_to_host(addr), len);
+}
+
+static const nemu_plugin_api api = {
+  .version = NEMU_PLUGIN_VERSION,
+  .size = sizeof(nemu_plugin_api),
+  .isa = str(__GUEST_ISA__),
+  .word_size = sizeof(word_t),
+  .register_block_cb = register_block_cb,
+  .register_insn_cb = register_insn_cb,
+  .register_mem_cb = register_mem_cb,
+  .register_dev_cb = register_dev_cb,
+  .register_exit_cb = register_exit_cb,
+  .read_reg = read_reg,
+  .read_mem = read_mem,
+};
+
+void plugin_insn(vaddr_t pc, uint32_t inst, bool is_jump) {
+  static bool block_start = true;
+  if (block_start) {
+    for (int i = 0; i < nr_block_cbs; i ++) block_cbs[i].cb(block_cbs[i].udata, pc);
+  }
+  block_start = is_jump;
+  for (int i = 0; i < nr_insn_cbs; i ++) insn_cbs[i].cb(insn_cbs[i].udata, pc, inst);
+}
+
+void plugin_mem(vaddr_t addr, int len, word_t data, bool is_write) {
+  for (int i = 0; i < nr_mem_cbs; i ++) mem_cbs[i].cb(mem_cbs[i].udata, cpu.pc, addr, len, data, is_write);
+}
+
+void plugin_dev(const char *dev, paddr_t addr, int len, word_t data, bool is_write) {
+  for (int i = 0; i < nr_dev_cbs; i ++) dev_cbs[i].cb(dev_cbs[i].udata, dev, cpu.pc, addr, len, data, is_write);
+}
+
+void plugin_exit() {
+  static bool done = false;
+  if (done) return;
+  done = true;
+  for (int i = 0; i < nr_exit_cbs; i ++) exit_cbs[i].cb(exit_cbs[i].udata);
+}
+
+void plugin_add(const char *spec) {
+  Assert(nr_plugin < NR_PLUGIN, "too many plugins");
+  plugin_spec[nr_plugin ++] = spec;
+}
+
+static void plugin_load(const char *spec) {
+  char file[PATH_MAX];
+  const char *comma = strchr(spec, ',');
+  int len = (comma ? comma - spec : strlen(spec));
+  Assert(len < sizeof(file), "plugin path too long");
+  memcpy(file, spec, len);
+  file[len] = '\0';
+
+  void *handle = dlopen(file, RTLD_NOW | RTLD_LOCAL);
+  Assert(handle, "Can not load plugin '%s': %s", file, dlerror());
+  int (*install)(const nemu_plugin_api *, const char *) = dlsym(handle, "nemu_plugin_install");
+  Assert(install, "'%s' is not a NEMU plugin: %s", file, dlerror());
+  int ret = install(&api, comma ? comma + 1 : "");
+  Assert(ret == 0, "plugin '%s' failed to install (%d)", file, ret);
+  Log("Plugin %s loaded", file);
+}
+
+void init_plugins() {
+  for (int i = 0; i < nr_plugin; i ++) plugin_load(plugin_spec[i]);
+}
+#endif
@@ -0,0 +1,40 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <prof.h>
+
+#ifdef CONFIG_SELF_PROF
+uint64_t prof_ticks[NR_PROF] = {}, prof_count[NR_PROF] = {}, prof_last = 0;
+int prof_cur = PROF_OTHER;
+
+void prof_report(uint64_t host_us) {
+  static const char *name[NR_PROF] = {
+    [PROF_OTHER] = "other", [PROF_FETCH] = "inst_fetch", [PROF_EXEC] = "decode_exec",
+    [PROF_MEM] = "paddr_read/write", [PROF_MMIO] = "mmio_read/write",
+    [PROF_DEVICE] = "device_update", [PROF_TRACE] = "trace_and_difftest",
+  };
+  uint64_t total = 0;
+  for (int i = 0; i < NR_PROF; i ++) total += prof_ticks[i];
+  if (total == 0) return;
+  _Log("host time by phase (%s):\n", PROF_CLOCK);
+  _Log("%-20s %18s %8s %12s %16s %10s\n", "phase", "ticks", "%", "time (us)", "calls", "ticks/call");
+  for (int i = 0; i < NR_PROF; i ++) {
+    _Log("%-20s %18" PRIu64 " %8.2f %12" PRIu64 " %16" PRIu64 " %10.1f\n", name[i], prof_ticks[i],
+        100.0 * prof_ticks[i] / total, (uint64_t)((double)host_us * prof_ticks[i] / total), prof_count[i],
+        prof_count[i] ? (double)prof_ticks[i] / prof_count[i] : 0);
+  }
+}
+#endif
@@ -0,0 +1,159 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <common.h>
+
+#ifdef CONFIG_SYMTAB
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+/* Function symbols of the guest program, sorted by address.
+ * A symbol covers [addr, addr + size); symbols without a size extend to
+ * the next symbol. Names point into a private copy of the ELF string table.
+ */
+typedef struct {
+  vaddr_t addr;
+  word_t size;
+  const char *name;
+  bool global;  // STB_GLOBAL or STB_WEAK
+} Symbol;
+
+static Symbol *syms = NULL;
+static int nr_sym = 0;
+static char *strtab = NULL;
+
+// remember recent lookups, most of them are repeated
+#define CACHE_SIZE 1024
+static struct {
+  vaddr_t addr;
+  int idx; // -1 means not found
+} cache[CACHE_SIZE];
+
+#define Elf_Ehdr MUXDEF(CONFIG_ISA64, Elf64_Ehdr, Elf32_Ehdr)
+#define Elf_Shdr MUXDEF(CONFIG_ISA64, Elf64_Shdr, Elf32_Shdr)
+#define Elf_Sym  MUXDEF(CONFIG_ISA64, Elf64_Sym , Elf32_Sym )
+#define ELF_ST_TYPE MUXDEF(CONFIG_ISA64, ELF64_ST_TYPE, ELF32_ST_TYPE)
+#define ELF_ST_BIND MUXDEF(CONFIG_ISA64, ELF64_ST_BIND, ELF32_ST_BIND)
+#define ELF_CLASS MUXDEF(CONFIG_ISA64, ELFCLASS64, ELFCLASS32)
+
+// by address, and among aliases the best name first: sized, then global,
+// then by name so that the choice does not depend on qsort()
+static int sym_cmp(const void *a, const void *b) {
+  const Symbol *x = a, *y = b;
+  if (x->addr != y->addr) return (x->addr > y->addr) - (x->addr < y->addr);
+  if ((x->size != 0) != (y->size != 0)) return (y->size != 0) - (x->size != 0);
+  if (x->global != y->global) return y->global - x->global;
+  return strcmp(x->name, y->name);
+}
+
+static void load_symbols(const uint8_t *elf, size_t len) {
+  const Elf_Ehdr *ehdr = (const Elf_Ehdr *)elf;
+  Assert(len >= sizeof(*ehdr) && memcmp(ehdr->e_ident, ELFMAG, SELFMAG) == 0 &&
+      ehdr->e_ident[EI_CLASS] == ELF_CLASS, "Not a valid %d-bit ELF file", (int)sizeof(word_t) * 8);
+  Assert(ehdr->e_shoff + (size_t)ehdr->e_shnum * sizeof(Elf_Shdr) <= len, "Corrupted section headers");
+  const Elf_Shdr *shdr = (const Elf_Shdr *)(elf + ehdr->e_shoff);
+
+  int i;
+  for (i = 0; i < ehdr->e_shnum && shdr[i].sh_type != SHT_SYMTAB; i ++) ;
+  if (i == ehdr->e_shnum) {
+    Log("No symbol table is found in the ELF file");
+    return;
+  }
+  const Elf_Shdr *sym_sh = &shdr[i], *str_sh = &shdr[sym_sh->sh_link];
+  Assert(sym_sh->sh_offset + sym_sh->sh_size <= len &&
+      str_sh->sh_offset + str_sh->sh_size <= len, "Corrupted symbol table");
+
+  strtab = malloc(str_sh->sh_size + 1);
+  memcpy(strtab, elf + str_sh->sh_offset, str_sh->sh_size);
+  strtab[str_sh->sh_size] = '\0';
+
+  const Elf_Sym *sym = (const Elf_Sym *)(elf + sym_sh->sh_offset);
+  int n = sym_sh->sh_size / sizeof(Elf_Sym);
+  syms = malloc(sizeof(Symbol) * n);
+  for (i = 0; i < n; i ++) {
+    if (ELF_ST_TYPE(sym[i].st_info) != STT_FUNC || sym[i].st_shndx == SHN_UNDEF) continue;
+    if (sym[i].st_name >= str_sh->sh_size) continue;
+    syms[nr_sym ++] = (Symbol) { .addr = sym[i].st_value, .size = sym[i].st_size,
+      .name = strtab + sym[i].st_name, .global = ELF_ST_BIND(sym[i].st_info) != STB_LOCAL };
+  }
+  qsort(syms, nr_sym, sizeof(Symbol), sym_cmp);
+
+  // drop aliases of the same address, keeping the first one
+  int k = 0;
+  for (i = 0; i < nr_sym; i ++) {
+    if (k > 0 && syms[k - 1].addr == syms[i].addr) continue;
+    syms[k ++] = syms[i];
+  }
+  nr_sym = k;
+}
+
+void init_symtab(const char *elf_file) {
+  for (int i = 0; i < CACHE_SIZE; i ++) cache[i].addr = 1, cache[i].idx = -1;
+  if (elf_file == NULL) {
+    Log("No ELF file is given, function names are not available");
+    return;
+  }
+
+  int fd = open(elf_file, O_RDONLY);
+  Assert(fd >= 0, "Can not open '%s'", elf_file);
+  struct stat st;
+  Assert(fstat(fd, &st) == 0, "Can not stat '%s'", elf_file);
+  void *elf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  Assert(elf != MAP_FAILED, "Can not map '%s'", elf_file);
+
+  load_symbols(elf, st.st_size);
+
+  munmap(elf, st.st_size);
+  close(fd);
+  Log("Read %d function symbols from %s", nr_sym, elf_file);
+}
+
+static int symtab_find(vaddr_t addr) {
+  // the last symbol whose address is not greater than `addr'
+  int lo = 0, hi = nr_sym;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (syms[mid].addr <= addr) lo = mid + 1;
+    else hi = mid;
+  }
+  int i = lo - 1;
+  if (i < 0) return -1;
+  if (syms[i].size != 0 && addr - syms[i].addr >= syms[i].size) return -1;
+  return i;
+}
+
+bool symtab_find_name(const char *name, vaddr_t *addr) {
+  for (int i = 0; i < nr_sym; i ++) {
+    if (strcmp(syms[i].name, name) == 0) { *addr = syms[i].addr; return true; }
+  }
+  return false;
+}
+
+const char *symtab_lookup(vaddr_t addr, vaddr_t *start) {
+  int h = (addr >> 2) & (CACHE_SIZE - 1);
+  if (cache[h].addr != addr) {
+    cache[h].addr = addr;
+    cache[h].idx = symtab_find(addr);
+  }
+  int i = cache[h].idx;
+  if (i < 0) return NULL;
+  if (start != NULL) *start = syms[i].addr;
+  return syms[i].name;
+}
+#endif
@@ -0,0 +1,77 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <common.h>
+
+#ifdef CONFIG_TELEMETRY
+/* Interval reports of a long run, one JSON object per line. A report is
+ * written every CONFIG_TELEMETRY_INST guest instructions or every
+ * CONFIG_TELEMETRY_MS ms of host time, whichever comes first. Host time is
+ * only looked at every TIME_STEP instructions to keep the check cheap.
+ */
+#define TIME_STEP 65536
+
+extern uint64_t g_nr_guest_inst;
+
+uint64_t telemetry_next = 0, telemetry_mmio = 0, trace_bytes = 0;
+static uint64_t step = 0;
+static FILE *fp = NULL;
+static struct { uint64_t time, inst, mmio; } last = {};
+
+static void report(vaddr_t pc, bool final) {
+  uint64_t now = get_time();
+  uint64_t us = now - last.time, inst = g_nr_guest_inst - last.inst;
+  fprintf(fp, "{\"time_us\":%" PRIu64 ",\"inst\":%" PRIu64 ",\"mips\":%.3f,"
+      "\"pc\":\"" FMT_WORD "\",\"sym\":", now, g_nr_guest_inst,
+      us ? (double)inst / us : 0.0, pc);
+  const char *sym = MUXDEF(CONFIG_SYMTAB, symtab_lookup(pc, NULL), NULL);
+  if (sym) fprintf(fp, "\"%s\"", sym);
+  else fputs("null", fp);
+  fprintf(fp, ",\"mmio_per_s\":%.1f,\"trace_bytes\":%" PRIu64 "%s}\n",
+      us ? (telemetry_mmio - last.mmio) * 1e6 / us : 0.0, trace_bytes,
+      final ? ",\"final\":true" : "");
+  fflush(fp);
+  last.time = now;
+  last.inst = g_nr_guest_inst;
+  last.mmio = telemetry_mmio;
+}
+
+void telemetry_tick(vaddr_t pc) {
+  telemetry_next = g_nr_guest_inst + step;
+  bool due = (CONFIG_TELEMETRY_INST > 0 && g_nr_guest_inst - last.inst >= CONFIG_TELEMETRY_INST) ||
+    (CONFIG_TELEMETRY_MS > 0 && get_time() - last.time >= CONFIG_TELEMETRY_MS * 1000ull);
+  if (due) report(pc, false);
+}
+
+void telemetry_report(vaddr_t pc) {
+  if (fp != NULL) report(pc, true);
+}
+
+void init_telemetry() {
+  Assert(CONFIG_TELEMETRY_INST > 0 || CONFIG_TELEMETRY_MS > 0,
+      "TELEMETRY_INST and TELEMETRY_MS can not both be 0");
+  const char *file = CONFIG_TELEMETRY_FILE;
+  fp = fopen(file, "w");
+  Assert(fp, "Can not open '%s'", file);
+  step = TIME_STEP;
+  if (CONFIG_TELEMETRY_MS == 0 || (CONFIG_TELEMETRY_INST > 0 && CONFIG_TELEMETRY_INST < TIME_STEP)) {
+    step = CONFIG_TELEMETRY_INST;
+  }
+  telemetry_next = step;
+  last.time = get_time();
+  Log("Telemetry is written to %s", file);
+}
+#endif
@@ -5,134 +5,39 @@
 
 #include <common.h>
 
-#include <elf.h>
-#include <stdlib.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <sys/stat.h>
-#include <sys/mman.h>
-
-#ifdef CONFIG_FTRACE
-
-#define FUNC_NAME_MAX 64
-#define FUNC_NUM_MAX 128 
-typedef struct {
-    uint32_t addr;
-    uint32_t size;
-    char func_name[FUNC_NAME_MAX];
-}FTRACE_FUNC;
-FTRACE_FUNC ftrace_func[FUNC_NUM_MAX];
-static uint32_t func_num = 0;
-
-void parse_elf(const char *elf_file) {
-    int fd;
-    struct stat file_stat;
-    Elf32_Ehdr *ehdr;
-    Elf32_Shdr *shdr;
-    Elf32_Sym *symtab;
-    char *strtab;
-    size_t shnum, i;
-
-    // Open the ELF file
-    if ((fd = open(elf_file, O_RDONLY, 0)) < 0) {
-        perror("open");
-        exit(1);
-    }
-
-    // Get file size
-    if (fstat(fd, &file_stat) < 0) {
-        perror("fstat");
-        exit(1);
-    }
-
-    // Memory map the file
-    void *map_start = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (map_start == MAP_FAILED) {
-        perror("mmap");
-        exit(1);
-    }
-
-    // ELF header
-    ehdr = (Elf32_Ehdr *)map_start;
-    // Section header table
-    shdr = (Elf32_Shdr *)((char *)map_start + ehdr->e_shoff);
-    // Number of sections
-    shnum = ehdr->e_shnum;
-    // Symbol table section
-    symtab = NULL;
-    for (i = 0; i < shnum; i++) {
-        if (shdr[i].sh_type == SHT_SYMTAB) {
-            symtab = (Elf32_Sym *)((char *)map_start + shdr[i].sh_offset);
-            break;
-        }
-    }
-    if (symtab == NULL) {
-        fprintf(stderr, "Symbol table not found.\n");
-        munmap(map_start, file_stat.st_size);
-        close(fd);
-        exit(1);
-    }
-
-    // String table section
-    strtab = (char *)((char *)map_start + shdr[shdr[i].sh_link].sh_offset);
+#ifdef CONFIG_FUNC_HOOK
+void trace_func_call(vaddr_t pc, vaddr_t target, bool is_tail_call) {
+  IFDEF(CONFIG_FTRACE, ftrace_call_print(pc, target, is_tail_call));
+  IFDEF(CONFIG_CALLGRAPH, callgraph_call(pc, target, is_tail_call));
+  IFDEF(CONFIG_PCSAMPLE, pcsample_call(pc, target, is_tail_call));
+}
 
-    // Iterate over symbols
-    for (int j = 0; j < shdr[i].sh_size / sizeof(Elf32_Sym); j++) {
-        if (ELF32_ST_TYPE(symtab[j].st_info) == STT_FUNC) {
-            if (func_num >= FUNC_NUM_MAX) {
-                fprintf(stderr, "Function amount out of range!\n");
-                exit(1);
-            }
-            printf("Symbol Name: %s, Value: 0x%x, Info: 0x%x, Size: %d\n", &strtab[symtab[j].st_name], symtab[j].st_value, symtab[j].st_info, symtab[j].st_size);
-            sprintf(ftrace_func[func_num].func_name, "%s",  &strtab[symtab[j].st_name]);
-            ftrace_func[func_num].size= symtab[j].st_size;
-            ftrace_func[func_num].addr = symtab[j].st_value;
-            func_num++;
-        }
-    }
-    // Clean up
-    munmap(map_start, file_stat.st_size);
-    close(fd);
+void trace_func_ret(vaddr_t pc, vaddr_t target) {
+  IFDEF(CONFIG_FTRACE, ftrace_ret_print(pc, target));
+  IFDEF(CONFIG_CALLGRAPH, callgraph_ret(pc, target));
+  IFDEF(CONFIG_PCSAMPLE, pcsample_ret());
 }
+#endif
 
-#define DOUBLE_SPACE "  "
+#ifdef CONFIG_FTRACE
 #define FTRACE_DEPTH_MAX  32
 static int ftrace_dep = 0;
 
+static int ftrace_indent() {
+    int dep = ftrace_dep < 0 ? 0 : (ftrace_dep > FTRACE_DEPTH_MAX ? FTRACE_DEPTH_MAX : ftrace_dep);
+    return dep * 2;
+}
+
 void ftrace_call_print(uint32_t inst_pc, uint32_t inst_des, bool is_tail_call) {
   ftrace_dep++;
-
-  char name[FUNC_NAME_MAX] = {'\0'};
-  char space[FTRACE_DEPTH_MAX * 2 + 1] = {'\0'};
-
-  for(int i = 0; i < func_num; i++){
-    if(inst_des == ftrace_func[i].addr){
-      strcpy(name, ftrace_func[i].func_name);
-      break;
-    }
-  }
-  for(int i = 0; i < ftrace_dep; i++){
-      strcat(space, DOUBLE_SPACE);
-  }
-  printf("0x%x: %scall [%s@0x%08x]\n", inst_pc, space, name, inst_des);
-
-  // usleep(500000);
+  const char *name = symtab_lookup(inst_des, NULL);
+  printf("0x%x: %*scall [%s@0x%08x]\n", inst_pc, ftrace_indent(), "", name ? name : "???", inst_des);
 }
 
 void ftrace_ret_print(uint32_t inst_pc, uint32_t inst_des) {
-
-  char name[FUNC_NAME_MAX] = {'\0'};
-  char space[FTRACE_DEPTH_MAX * 2 + 1] = {'\0'};
-  for(int i = 0; i < func_num; i++){
-    if(inst_des == ftrace_func[i].addr){
-      strcpy(name, ftrace_func[i].func_name);
-      break;
-    }
-  }
-  for(int i = 0; i < ftrace_dep; i++){
-      strcat(space, DOUBLE_SPACE);
-  }
-  printf("0x%x: %sret [\33[1;31m%s@0x%08x\33[0m]\n",inst_pc, space, strlen(name) == 0 ? "???" : name ,inst_des);
+  // the return address is inside the caller
+  const char *name = symtab_lookup(inst_des, NULL);
+  printf("0x%x: %*sret [\33[1;31m%s@0x%08x\33[0m]\n", inst_pc, ftrace_indent(), "", name ? name : "???", inst_des);
   ftrace_dep--;
   /*
    *  TODO : realize tail-recursive function name print
@@ -145,24 +50,35 @@ void ftrace_ret_print(uint32_t inst_pc, uint32_t inst_des) {
  * datastruct for itrace
  */
 #ifdef CONFIG_ITRACE_COND
-#define MAX_IRINGBUF 8
+// only the raw instruction is kept, it is disassembled when displayed
+#define MAX_IRINGBUF CONFIG_ITRACE_RING_SIZE
+static_assert((MAX_IRINGBUF & (MAX_IRINGBUF - 1)) == 0, "ITRACE_RING_SIZE must be a power of 2");
 typedef struct {
-    char logbuf[64];
+    vaddr_t pc;
+    uint32_t inst;
 } ItraceNode;
-ItraceNode iringbuf[MAX_IRINGBUF];
-static uint32_t inode = 0;
+static ItraceNode iringbuf[MAX_IRINGBUF];
+static uint64_t inode = 0;
 
-void write_iring(char *buf) {
-    int idx = inode++ % MAX_IRINGBUF;
-    strcpy(iringbuf[idx].logbuf, buf);
+void write_iring(vaddr_t pc, uint32_t inst) {
+    ItraceNode *n = &iringbuf[inode++ & (MAX_IRINGBUF - 1)];
+    n->pc = pc;
+    n->inst = inst;
 }
 
 void iring_display() {
-    for(int i = 0; i< MAX_IRINGBUF; i++){
-        if(unlikely(i == ((inode % MAX_IRINGBUF == 0) ? MAX_IRINGBUF - 1 : inode % MAX_IRINGBUF - 1)))
-        printf("\33[1;31m --> %s\n\33[0m", iringbuf[i].logbuf);
-    else
-        printf("     %s\n", iringbuf[i].logbuf);
+    // from the oldest to the latest instruction
+    uint64_t start = (inode > MAX_IRINGBUF ? inode - MAX_IRINGBUF : 0);
+    char buf[128];
+    for (uint64_t i = start; i != inode; i++) {
+        ItraceNode *n = &iringbuf[i & (MAX_IRINGBUF - 1)];
+        // the ring does not record the length of an instruction,
+        // which is fine for all ISAs with fixed-length instructions
+        itrace_format(buf, sizeof(buf), n->pc, (uint8_t *)&n->inst, 4);
+        if (unlikely(i + 1 == inode))
+            printf("\33[1;31m --> %s\n\33[0m", buf);
+        else
+            printf("     %s\n", buf);
     }
 }
 #endif
@@ -0,0 +1,168 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <common.h>
+
+#ifdef CONFIG_TRACE_TRIGGER
+/* Runtime triggers which turn tracing on or off. A trigger fires once, when
+ * the guest reaches a pc, executes a number of instructions or writes to an
+ * address. The execute loop only compares the instruction count with
+ * `trigger_next', the count at which the next instruction trigger fires, or
+ * 0 while a pc trigger is pending. paddr_write() only tests
+ * `trigger_wr_armed', which stays false while no write trigger is pending.
+ */
+#define NR_TRIGGER 16
+#define NR_SPEC    16
+
+enum { TRIG_PC, TRIG_INST, TRIG_WRITE };
+
+typedef struct {
+  int kind;
+  bool on;
+  uint64_t val;
+} Trigger;
+
+extern uint64_t g_nr_guest_inst;
+
+uint64_t trigger_next = UINT64_MAX;
+bool trigger_wr_armed = false;
+static Trigger triggers[NR_TRIGGER];
+static int nr_trigger = 0;
+static const char *trigger_spec[NR_SPEC];
+static int nr_spec = 0;
+
+static const char *kind_name[] = { [TRIG_PC] = "pc", [TRIG_INST] = "inst", [TRIG_WRITE] = "write" };
+
+static void update_armed() {
+  trigger_next = UINT64_MAX;
+  trigger_wr_armed = false;
+  for (int i = 0; i < nr_trigger; i ++) {
+    switch (triggers[i].kind) {
+      case TRIG_PC: trigger_next = 0; break;
+      case TRIG_INST: if (triggers[i].val < trigger_next) trigger_next = triggers[i].val; break;
+      case TRIG_WRITE: trigger_wr_armed = true; break;
+    }
+  }
+}
+
+static void fire(int i) {
+  trace_on = triggers[i].on;
+  log_printf("[trigger] trace %s at %s = " FMT_WORD ", inst = %" PRIu64 "\n",
+      trace_on ? "on" : "off", kind_name[triggers[i].kind], (word_t)triggers[i].val, g_nr_guest_inst);
+  triggers[i] = triggers[-- nr_trigger];
+}
+
+void trigger_check(vaddr_t pc) {
+  for (int i = nr_trigger - 1; i >= 0; i --) {
+    Trigger *t = &triggers[i];
+    if ((t->kind == TRIG_PC && t->val == pc) || (t->kind == TRIG_INST && g_nr_guest_inst >= t->val)) fire(i);
+  }
+  update_armed();
+}
+
+// fire the write triggers on an address in [addr, addr + len)
+void trigger_write(paddr_t addr, int len) {
+  for (int i = nr_trigger - 1; i >= 0; i --) {
+    if (triggers[i].kind == TRIG_WRITE && triggers[i].val - addr < (uint64_t)len) fire(i);
+  }
+  update_armed();
+}
+
+/* `action' is "on" or "off". `cond' is one of "pc=ADDR", "sym=NAME",
+ * "inst=N" and "write=ADDR", or NULL to take effect at once.
+ */
+bool trigger_add(const char *action, const char *cond) {
+  bool on;
+  if (strcmp(action, "on") == 0) on = true;
+  else if (strcmp(action, "off") == 0) on = false;
+  else { printf("Unknown trace action '%s'\n", action); return false; }
+
+  if (cond == NULL) {
+    trace_on = on;
+    return true;
+  }
+  if (nr_trigger == NR_TRIGGER) { printf("Too many trace triggers\n"); return false; }
+
+  Trigger t = { .on = on };
+  const char *eq = strchr(cond, '=');
+  if (eq == NULL) { printf("Bad trace trigger '%s'\n", cond); return false; }
+  const char *arg = eq + 1;
+  int klen = eq - cond;
+  char *end = NULL;
+  if (klen == 3 && strncmp(cond, "sym", 3) == 0) {
+    vaddr_t addr;
+    if (!MUXDEF(CONFIG_SYMTAB, symtab_find_name(arg, &addr), false)) {
+      printf("Unknown symbol '%s'\n", arg);
+      return false;
+    }
+    t.kind = TRIG_PC;
+    t.val = addr;
+  } else {
+    if (klen == 2 && strncmp(cond, "pc", 2) == 0) t.kind = TRIG_PC;
+    else if (klen == 4 && strncmp(cond, "inst", 4) == 0) t.kind = TRIG_INST;
+    else if (klen == 5 && strncmp(cond, "write", 5) == 0) t.kind = TRIG_WRITE;
+    else { printf("Bad trace trigger '%s'\n", cond); return false; }
+    t.val = strtoull(arg, &end, 0);
+    if (end == arg || *end != '\0') { printf("Bad number '%s'\n", arg); return false; }
+  }
+  triggers[nr_trigger ++] = t;
+  update_armed();
+  return true;
+}
+
+void trigger_clear() {
+  nr_trigger = 0;
+  update_armed();
+}
+
+void trigger_display() {
+  printf("trace is %s\n", trace_on ? "on" : "off");
+  for (int i = 0; i < nr_trigger; i ++) {
+    printf("%-4s at %-5s = 0x%" PRIx64 "\n", triggers[i].on ? "on" : "off",
+        kind_name[triggers[i].kind], triggers[i].val);
+  }
+}
+
+// triggers given on the command line are added after the symbols are loaded
+void trigger_add_spec(const char *spec) {
+  Assert(nr_spec < NR_SPEC, "too many trace triggers");
+  trigger_spec[nr_spec ++] = spec;
+}
+
+/* Without triggers on the command line, trace from CONFIG_TRACE_START to
+ * CONFIG_TRACE_END as before, `trace_on' already starts as set up for
+ * CONFIG_TRACE_START in log.c. Otherwise tracing turns off here, and only
+ * the given triggers decide when it is on.
+ */
+void init_trigger() {
+  if (nr_spec == 0) {
+    if (CONFIG_TRACE_START > 0) triggers[nr_trigger ++] = (Trigger) { TRIG_INST, true, CONFIG_TRACE_START };
+    triggers[nr_trigger ++] = (Trigger) { TRIG_INST, false, CONFIG_TRACE_END + 1ull };
+  } else {
+    trace_on = false;
+  }
+
+  for (int i = 0; i < nr_spec; i ++) {
+    char buf[128];
+    Assert(strlen(trigger_spec[i]) < sizeof(buf), "trace trigger '%s' is too long", trigger_spec[i]);
+    strcpy(buf, trigger_spec[i]);
+    char *cond = strchr(buf, ':');
+    if (cond != NULL) *cond ++ = '\0';
+    Assert(trigger_add(buf, cond), "Bad trace trigger '%s'", trigger_spec[i]);
+  }
+  update_armed();
+}
+#endif
@@ -0,0 +1,133 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+/* Decode binary trace files written by NEMU, see include/trace-def.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <trace-def.h>
+
+void init_disasm(const char *triple);
+void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte);
+
+static uint64_t pc_lo = 0, pc_hi = UINT64_MAX;
+static uint64_t addr_lo = 0, addr_hi = UINT64_MAX;
+static uint64_t max_rec = UINT64_MAX;
+static bool raw = false;
+
+static uint64_t read_word(const uint8_t *p, int size) {
+  uint64_t v = 0;
+  memcpy(&v, p, size);
+  return v;
+}
+
+static void print_itrace(const TraceHeader *h, const uint8_t *rec) {
+  uint64_t pc = read_word(rec, h->word_size);
+  uint32_t inst;
+  memcpy(&inst, rec + h->word_size, sizeof(inst));
+  if (pc < pc_lo || pc > pc_hi) return;
+
+  int w = h->word_size * 2;
+  if (raw) {
+    printf("0x%0*" PRIx64 ": %08" PRIx32 "\n", w, pc, inst);
+    return;
+  }
+  char buf[128];
+  disassemble(buf, sizeof(buf), pc, (uint8_t *)&inst, sizeof(inst));
+  uint8_t *b = (uint8_t *)&inst;
+  printf("0x%0*" PRIx64 ": %02x %02x %02x %02x  %s\n", w, pc, b[3], b[2], b[1], b[0], buf);
+}
+
+static void print_mtrace(const TraceHeader *h, const uint8_t *rec) {
+  int ws = h->word_size;
+  uint64_t pc = read_word(rec, ws);
+  uint64_t addr = read_word(rec + ws, 8);
+  uint64_t data = read_word(rec + ws + 8, ws);
+  uint8_t info = rec[2 * ws + 8];
+  if (pc < pc_lo || pc > pc_hi || addr < addr_lo || addr > addr_hi) return;
+
+  int len = info & ~MTRACE_WRITE;
+  printf("0x%0*" PRIx64 ": %c%d 0x%0*" PRIx64 " %s 0x%0*" PRIx64 "\n", ws * 2, pc,
+      (info & MTRACE_WRITE) ? 'W' : 'R', len, ws * 2, addr,
+      (info & MTRACE_WRITE) ? "<-" : "->", len * 2, data);
+}
+
+static void usage(const char *name) {
+  printf("Usage: %s [OPTION...] TRACE_FILE\n\n", name);
+  printf("\t-p,--pc=LO:HI           only show records whose pc is in [LO, HI]\n");
+  printf("\t-a,--addr=LO:HI         only show memory accesses whose address is in [LO, HI]\n");
+  printf("\t-n,--count=N            stop after N records\n");
+  printf("\t-r,--raw                do not disassemble\n");
+  printf("\n");
+  exit(0);
+}
+
+int main(int argc, char *argv[]) {
+  const struct option table[] = {
+    {"pc"       , required_argument, NULL, 'p'},
+    {"addr"     , required_argument, NULL, 'a'},
+    {"count"    , required_argument, NULL, 'n'},
+    {"raw"      , no_argument      , NULL, 'r'},
+    {"help"     , no_argument      , NULL, 'h'},
+    {0          , 0                , NULL,  0 },
+  };
+  int o;
+  while ( (o = getopt_long(argc, argv, "p:a:n:rh", table, NULL)) != -1) {
+    switch (o) {
+      case 'p':
+        if (sscanf(optarg, "%" SCNx64 ":%" SCNx64, &pc_lo, &pc_hi) != 2) usage(argv[0]);
+        break;
+      case 'a':
+        if (sscanf(optarg, "%" SCNx64 ":%" SCNx64, &addr_lo, &addr_hi) != 2) usage(argv[0]);
+        break;
+      case 'n': sscanf(optarg, "%" SCNu64, &max_rec); break;
+      case 'r': raw = true; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1) usage(argv[0]);
+
+  FILE *fp = fopen(argv[optind], "rb");
+  if (fp == NULL) { perror(argv[optind]); return 1; }
+
+  TraceHeader h;
+  if (fread(&h, sizeof(h), 1, fp) != 1 || memcmp(h.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+    fprintf(stderr, "%s: not a NEMU trace file\n", argv[optind]);
+    return 1;
+  }
+  uint32_t rec_size = (h.type == TRACE_TYPE_ITRACE ? ITRACE_REC_SIZE(h.word_size) :
+                       h.type == TRACE_TYPE_MTRACE || h.type == TRACE_TYPE_DTRACE ?
+                       MTRACE_REC_SIZE(h.word_size) : 0);
+  if (h.version != TRACE_VERSION || h.word_size > sizeof(uint64_t) || rec_size == 0 || h.rec_size != rec_size) {
+    fprintf(stderr, "%s: unsupported trace (version %u, type %u)\n", argv[optind], h.version, h.type);
+    return 1;
+  }
+  h.triple[sizeof(h.triple) - 1] = '\0';
+  if (!raw && h.type == TRACE_TYPE_ITRACE) init_disasm(h.triple);
+
+  uint8_t rec[64];
+  for (uint64_t n = 0; n < max_rec && fread(rec, h.rec_size, 1, fp) == 1; n ++) {
+    if (h.type == TRACE_TYPE_ITRACE) print_itrace(&h, rec);
+    else print_mtrace(&h, rec);
+  }
+  fclose(fp);
+  return 0;
+}
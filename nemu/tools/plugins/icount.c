@@ -0,0 +1,60 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+/* An example plugin: count the executed instructions, basic blocks and
+ * memory accesses, optionally only those of guest pc in [LO, HI].
+ *   nemu --plugin=build/icount-so[,LO:HI] ...
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <nemu-plugin.h>
+
+static uint64_t lo = 0, hi = UINT64_MAX;
+static uint64_t nr_insn = 0, nr_block = 0, nr_read = 0, nr_write = 0;
+
+static void on_block(void *udata, uint64_t pc) {
+  if (pc >= lo && pc <= hi) nr_block ++;
+}
+
+static void on_insn(void *udata, uint64_t pc, uint32_t inst) {
+  if (pc >= lo && pc <= hi) nr_insn ++;
+}
+
+static void on_mem(void *udata, uint64_t pc, uint64_t addr, int len, uint64_t data, bool is_write) {
+  if (pc < lo || pc > hi) return;
+  if (is_write) nr_write ++;
+  else nr_read ++;
+}
+
+static void on_exit(void *udata) {
+  printf("icount: %" PRIu64 " instructions, %" PRIu64 " blocks (%.2f instructions/block), "
+      "%" PRIu64 " reads, %" PRIu64 " writes\n", nr_insn, nr_block,
+      nr_block ? (double)nr_insn / nr_block : 0, nr_read, nr_write);
+}
+
+int nemu_plugin_install(const nemu_plugin_api *api, const char *args) {
+  if (api->version != NEMU_PLUGIN_VERSION) return -1;
+  if (args[0] != '\0' && sscanf(args, "%" SCNx64 ":%" SCNx64, &lo, &hi) != 2) {
+    fprintf(stderr, "icount: bad range '%s', expect LO:HI\n", args);
+    return -1;
+  }
+  api->register_block_cb(on_block, NULL);
+  api->register_insn_cb(on_insn, NULL);
+  api->register_mem_cb(on_mem, NULL);
+  api->register_exit_cb(on_exit, NULL);
+  return 0;
+}